@@ -1,18 +1,80 @@
-#/bin/zsh!
+#!/bin/bash
+#
+# Build every type of every file in benchmarks.txt, one process per
+# run, up to JOBS runs at once.  Each file is parsed once into its
+# netlist cache, which every run of it loads.  Each run is limited
+# to MEM_KB of address space (ulimit -v) and SECS seconds, and the
+# statistics of all runs are merged into one CSV table, RESULTS.
+# FLAGS go to every run (they must agree on the ordering, which is
+# part of the cache).
+#
 
 filelist="benchmarks.txt"
+jobs=${JOBS:-$(nproc)}
+# address space per run in KB, as for ulimit -v
+mem=${MEM_KB:-unlimited}
+secs=${SECS:-3600}
+flags=${FLAGS:--g}
+results=${RESULTS:-results.csv}
+types="0 11 8 4 6 2 7 3 10 9 5 1"
 
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+export mem secs flags work
+
+# one run: file type; its statistics go to $work/<n>.csv, and the
+# files and types that left none to $work/failed
+run() {
+    file=$1
+    type=$2
+    out="$work/$(basename "${file%.blif}").$type"
+    (
+        ulimit -v $mem
+        # -T stops the build and still writes its statistics;
+        # the timeout is for a run that doesn't get that far
+        exec timeout -s KILL $((secs + 60)) ./blif2bdd $flags \
+            -C "${file%.blif}.netcache" -t $type -T $secs -Xc "$out.csv" \
+            < "$file"
+    ) > "$out.log" 2>&1
+    code=$?
+    if ! grep -q '^"run"' "$out.csv" 2>/dev/null; then
+        echo "$file,$type,exit $code" >> "$work/failed"
+    fi
+    echo "$file type $type: exit $code" >&2
+}
+export -f run
+
+# parse each file once
+xargs -P "$jobs" -I{} sh -c \
+    './blif2bdd $flags -Cw "${1%.blif}.netcache" < "$1" > /dev/null 2>&1 ||
+        echo "$1: parse failed" >&2' _ {} < "$filelist"
+
+# every type of every file
 while IFS= read -r file_name; do
-	./blif2bdd < $file_name -g -f -t 0
-	./blif2bdd < $file_name -g -f -t 11
-	./blif2bdd < $file_name -g -f -t 8
-	./blif2bdd < $file_name -g -f -t 4
-	./blif2bdd < $file_name -g -f -t 6
-	./blif2bdd < $file_name -g -f -t 2
-	./blif2bdd < $file_name -g -f -t 7
-	./blif2bdd < $file_name -g -f -t 3
-	./blif2bdd < $file_name -g -f -t 10
-	./blif2bdd < $file_name -g -f -t 9
-	./blif2bdd < $file_name -g -f -t 5
-	./blif2bdd < $file_name -g -f -t 1
-done < "$filelist"
+    for t in $types; do
+        echo "$file_name $t"
+    done
+done < "$filelist" | xargs -P "$jobs" -n 2 bash -c 'run "$@"' _
+
+# merge: one header, then every record; runs that wrote no statistics
+# (killed, out of memory) get a run line with their exit status
+csvs=("$work"/*.csv)
+if [ -e "${csvs[0]}" ]; then
+    head -n 1 "${csvs[0]}" > "$results"
+    for f in "${csvs[@]}"; do
+        tail -n +2 "$f"
+    done >> "$results"
+else
+    echo "record,model,type,ordering,out_order,partition,status" > "$results"
+fi
+if [ -e "$work/failed" ]; then
+    columns=$(head -n 1 "$results" | tr -cd , | wc -c)
+    while IFS=, read -r file type status; do
+        line="\"run\",\"$(basename "${file%.blif}")\",\"$type\",,,,\"$status\""
+        pad=$((columns - 6))
+        printf '%s' "$line"
+        for ((i=0; i<pad; i++)); do printf ','; done
+        printf '\n'
+    done < "$work/failed" >> "$results"
+fi
+echo "Results in $results" >&2
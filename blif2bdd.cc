@@ -1,9 +1,27 @@
 #include <iostream>
 #include <iomanip>
 #include <ctime>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 #include "blif_par.h"
 #include "blif_expr.h"
+#include "blif_cache.h"
+#include "blif_pipe.h"
+#include "blif_sched.h"
+#include "blif_gc.h"
+#include "blif_order.h"
+#include "blif_reorder.h"
+#include "blif_fold.h"
+#include "blif_build.h"
+#include "blif_stats.h"
+#include "blif_phase.h"
 #include "rexdd.h"
 #include "timer.h"
 
@@ -17,11 +35,50 @@ static const unsigned ORDER_FILE_BOT    = 1;
 static const unsigned ORDER_WEIGHT_TOP  = 2;
 static const unsigned ORDER_WEIGHT_BOT  = 3;
 
+static const unsigned ORDER_DFS_TOP     = 4;
+static const unsigned ORDER_DFS_BOT     = 5;
+
+static const unsigned ORDER_INTER_TOP   = 6;
+static const unsigned ORDER_INTER_BOT   = 7;
+
+static const unsigned ORDER_LEVEL_TOP   = 8;
+static const unsigned ORDER_LEVEL_BOT   = 9;
+
 inline bool needs_weights(unsigned order)
+{
+    return (ORDER_WEIGHT_TOP == order) || (ORDER_WEIGHT_BOT == order);
+}
+
+// Anything but file order needs the whole netlist first
+inline bool needs_netlist(unsigned order)
 {
     return (order > ORDER_FILE_BOT);
 }
 
+//
+// Output order choices
+//
+
+static const unsigned OUTPUTS_FILE      = 0;
+static const unsigned OUTPUTS_DEPTH     = 1;
+static const unsigned OUTPUTS_SIZE      = 2;
+static const unsigned OUTPUTS_CLUSTER   = 3;
+
+// The switch for an ordering, for messages
+inline const char* order_switch(unsigned order)
+{
+    static const char* sw[] = {
+        "-oF", "-of", "-oW", "-ow", "-oD", "-od", "-oI", "-oi", "-oL", "-ol"
+    };
+    return (order <= ORDER_LEVEL_BOT) ? sw[order] : "?";
+}
+
+inline const char* outputs_switch(unsigned order)
+{
+    static const char* sw[] = { "-Of", "-Od", "-Os", "-Oc" };
+    return (order <= OUTPUTS_CLUSTER) ? sw[order] : "?";
+}
+
 /*
  *  Used for lexer testing
  */
@@ -91,16 +148,39 @@ bool update_weight(symbol* s)
         s->weight = 1;
         return true;
     }
-    s->weight = 0;
+    // a partial sum would look final to the fan-ins, so keep 0 until done
+    unsigned wt = 0;
     for (const symlist* p = s->parents; p; p=p->next) {
         if (0==p->item->weight) return false;
-        s->weight += p->item->weight;
+        // weights count paths to outputs, so saturate instead of wrapping
+        if (wt > 0xffffffff - p->item->weight) {
+            wt = 0xffffffff;
+        } else {
+            wt += p->item->weight;
+        }
     }
+    s->weight = wt;
     return true;
 }
 
+// helper function for determine_weights:
+// every symbol left waiting has a parent without a weight,
+// so following those parents must come around to a loop
+void report_weight_loop(const symbol* s)
+{
+    std::unordered_set<const symbol*> seen;
+    while (seen.insert(s).second) {
+        const symlist* p = s->parents;
+        while (p->item->weight) p = p->next;
+        s = p->item;
+    }
+    std::cerr << "Error line " << s->lineno << ":\n    ";
+    std::cerr << "Combinational loop through " << s->name << "\n";
+    throw 2;
+}
+
 /*
- * Determine symbol weights
+ * Determine symbol weights; throws 2 on a combinational loop
  */
 void determine_weights(symbol* &st)
 {
@@ -114,6 +194,7 @@ void determine_weights(symbol* &st)
     while (waiting) {
         symbol* proc = waiting;
         waiting = nullptr;
+        bool progress = false;
 
         while (proc) {
             symbol* ptr = proc;
@@ -123,12 +204,14 @@ void determine_weights(symbol* &st)
                 // This one is done, add to st list
                 ptr->next = st;
                 st = ptr;
+                progress = true;
             } else {
                 // Not done, add back to waiting list
                 ptr->next = waiting;
                 waiting = ptr;
             }
         }
+        if (!progress) report_weight_loop(waiting);
     }
 
     // Now, sort by weights
@@ -143,7 +226,7 @@ void determine_weights(symbol* &st)
     st = ordered;
 }
 
-unsigned determine_levels(symbol* IN, unsigned ordering)
+unsigned determine_levels(symbol* IN, symbol* ST, unsigned ordering)
 {
     unsigned num_vars = 0;
     for (const symbol* p = IN; p; p=p->next) {
@@ -157,11 +240,90 @@ unsigned determine_levels(symbol* IN, unsigned ordering)
         return num_vars;
     }
 
-    // TBD: weights
+    //
+    // Rank the inputs; the first goes on top for the upper case
+    // switches, at the bottom otherwise.
+    // Input levels are still their position in the file here.
+    //
+    std::vector<symbol*> ranked;
+    switch (ordering) {
+        case ORDER_DFS_TOP:
+        case ORDER_DFS_BOT:
+            order_dfs(ST, IN, ranked);
+            break;
+
+        case ORDER_INTER_TOP:
+        case ORDER_INTER_BOT:
+            order_interleave(ST, IN, ranked);
+            break;
+
+        case ORDER_LEVEL_TOP:
+        case ORDER_LEVEL_BOT:
+            order_level(ST, IN, ranked);
+            break;
+
+        default:
+            //
+            // By weight; ties keep file order (first .input nearest the
+            // heavy end), so the result does not depend on list order.
+            //
+            for (symbol* p = IN; p; p=p->next) {
+                ranked.push_back(p);
+            }
+            std::sort(ranked.begin(), ranked.end(),
+                [](const symbol* a, const symbol* b) {
+                    if (a->weight != b->weight) return a->weight > b->weight;
+                    return a->level < b->level;
+                }
+            );
+    }
+    ASSERT(ranked.size() == num_vars);
+
+    const bool top = (ordering % 2) == 0;   // ORDER_..._TOP
+    for (unsigned i=0; i<num_vars; i++) {
+        if (top) {
+            ranked[i]->level = num_vars - i;
+        } else {
+            ranked[i]->level = i+1;
+        }
+    }
 
     return num_vars;
 }
 
+/*
+ * Put the outputs first in the symbol list, in the chosen order;
+ * the build loop takes them in list order.
+ */
+void order_outputs(symbol* &st, symbol* IN, unsigned how)
+{
+    PHASE("output order");
+    std::vector<symbol*> outs;
+    switch (how) {
+        case OUTPUTS_DEPTH:     outputs_by_depth(st, IN, outs);     break;
+        case OUTPUTS_SIZE:      outputs_by_size(st, IN, outs);      break;
+        case OUTPUTS_CLUSTER:   outputs_by_cluster(st, IN, outs);   break;
+        default:                return;
+    }
+    if (outs.empty()) return;
+
+    // the rest keep their order
+    symbol* rest = nullptr;
+    symbol** tail = &rest;
+    for (symbol* p = st; p; p=p->next) {
+        if (OUTPUT == p->type) continue;
+        *tail = p;
+        tail = &p->next;
+    }
+    *tail = nullptr;
+
+    for (unsigned k=0; k+1<outs.size(); k++) {
+        outs[k]->next = outs[k+1];
+    }
+    outs.back()->next = rest;
+    st = outs[0];
+}
+
 unsigned determine_outputs(symbol* IN)
 {
     unsigned num_vars = 0;
@@ -171,23 +333,6 @@ unsigned determine_outputs(symbol* IN)
     return num_vars;
 }
 
-uint64_t mark_and_count(rexdd_forest_t *F, rexdd_edge_t *e)
-{
-    unmark_forest(F);
-    mark_nodes(F, e->target);
-    uint_fast64_t q, n;
-    uint64_t num_nodes = 0;
-    for (q=0; q<F->M->pages_size; q++) {
-        const rexdd_nodepage_t *page = F->M->pages+q;
-        for (n=0; n<page->first_unalloc; n++) {
-            if (rexdd_is_packed_marked(page->chunk+n)) {
-                num_nodes++;
-            }
-        } // for n
-    } // for p
-    return num_nodes;
-}
-
 /*
  *  link list of inputs to array on index of level
  */
@@ -220,6 +365,180 @@ void store_inputs_by_level(symbol* &IN, symbol** out, unsigned num_vars)
   std::cerr << "(BOTTOM)\n";
 }
 
+/*
+ *  Inputs sorted by level; before determine_levels(),
+ *  that is file order
+ */
+void inputs_by_level(const symbol* IN, std::vector<symbol*> &out)
+{
+    out.clear();
+    for (const symbol* p = IN; p; p=p->next) {
+        out.push_back(const_cast<symbol*>(p));
+    }
+    std::sort(out.begin(), out.end(),
+        [](const symbol* a, const symbol* b) {
+            return a->level < b->level;
+        }
+    );
+}
+
+/*
+ * Trial for reordering (-r): rank the inputs in base (file order)
+ * by ordering, then in a fresh forest in S build them and the first
+ * pos gates of a new schedule, which replaces sched.
+ * Collects garbage with the thresholds of gc, and gives up,
+ * returning false, as soon as a collection leaves more than cap
+ * live nodes, or the unique table holds more than room nodes;
+ * S must be freed either way.
+ *
+ *      @param  size    On success: live nodes at the end
+ */
+bool rebuild(build_state &S, char bdd_type, unsigned ordering,
+        const std::vector<symbol*> &base, symbol* slist, symbol** inputs,
+        build_schedule* &sched, unsigned outputs, unsigned pos,
+        const gc_policy &thresholds, uint64_t cap, uint64_t room,
+        uint64_t &size)
+{
+    const unsigned num_vars = base.size();
+    for (symbol* q=slist; q; q=q->next) {
+        if (q->build) q->build->forget_levels();
+    }
+
+    // determine_levels() wants a list, with levels in file order
+    symbol* IN = nullptr;
+    for (unsigned i=num_vars; i; i--) {
+        base[i-1]->level = i;
+        base[i-1]->next = IN;
+        IN = base[i-1];
+    }
+    determine_levels(IN, slist, ordering);
+    for (unsigned i=0; i<num_vars; i++) {
+        base[i]->next = nullptr;
+        inputs[base[i]->level] = base[i];
+    }
+
+    S.init_forest(bdd_type, num_vars);
+    for (unsigned i=1; i<=num_vars; i++) {
+        S.build_input(inputs[i]);
+    }
+
+    delete sched;
+    sched = new build_schedule(slist, outputs, S);
+    ASSERT(pos <= sched->numGates());
+    rexdd_forest_t *F = &S.F;
+    gc_policy gc = thresholds.restart();
+    for (unsigned i=0; i<pos; i++) {
+        S.build(sched->gate(i));
+        sched->built(i);
+        if (F->UT->num_entries > room) return false;
+        if (!gc.due(*F)) continue;
+        const uint64_t before = F->UT->num_entries;
+        S.collect_garbage();
+        gc.collected(before, *F, 0);
+        if (F->UT->num_entries > cap) return false;
+    }
+    S.collect_garbage();
+    size = F->UT->num_entries;
+    return size <= cap;
+}
+
+/*
+ * Input levels, by position in base, and every gate's operand
+ * order; each schedule rearranges the operands for the levels
+ */
+struct arrangement {
+    std::vector<unsigned> levels;
+    std::vector<unsigned> operands;
+
+    void save(const std::vector<symbol*> &base, const symbol* slist) {
+        levels.resize(base.size());
+        for (unsigned i=0; i<base.size(); i++) {
+            levels[i] = base[i]->level;
+        }
+        operands.clear();
+        for (const symbol* q=slist; q; q=q->next) {
+            if (q->build) q->build->save_arrangement(operands);
+        }
+    }
+
+    void restore(const std::vector<symbol*> &base, symbol* slist,
+            symbol** inputs) const
+    {
+        for (unsigned i=0; i<base.size(); i++) {
+            base[i]->level = levels[i];
+            inputs[levels[i]] = base[i];
+        }
+        unsigned at = 0;
+        for (symbol* q=slist; q; q=q->next) {
+            if (!q->build) continue;
+            q->build->restore_arrangement(operands, at);
+            q->build->forget_levels();
+        }
+    }
+};
+
+/*
+ * Reorder (-r), after the first pos gates of the schedule are built
+ * and garbage collected.  Each other static ordering is tried on
+ * those gates in a forest of its own, beside S.  A trial that leaves
+ * fewer live nodes than S takes S's place, with its schedule, and
+ * S's forest is freed; so there are never more than two forests.
+ * A trial is given up once it has more live nodes than the best so
+ * far, or more nodes than fit in the memory left (or -M node_limit).
+ * Trials collect garbage with the thresholds of gc.
+ * Weight orderings are only tried if weights were computed.
+ *
+ *      @return True if S was replaced under another ordering
+ */
+bool reorder(build_state &S, char bdd_type, unsigned &ordering,
+        bool have_weights, const std::vector<symbol*> &base, symbol* slist,
+        symbol** inputs, build_schedule* &sched, unsigned outputs,
+        unsigned pos, const gc_policy &gc, uint64_t node_limit,
+        reorder_policy &R)
+{
+    PHASE("reorder");
+    timer rtime;
+    const uint64_t before = S.F.UT->num_entries;
+    const uint64_t room = R.room(S.F, node_limit);
+    // the trials change the input levels and the operand order;
+    // this is what S uses
+    arrangement kept;
+    kept.save(base, slist);
+
+    unsigned best = ordering;
+    uint64_t best_size = before;
+    build_state T(S.P);
+    build_schedule* trial = nullptr;
+    for (unsigned o=ORDER_FILE_TOP; o<=ORDER_LEVEL_BOT; o++) {
+        if (o == ordering) continue;
+        if (needs_weights(o) && !have_weights) continue;
+        uint64_t size;
+        const bool done = rebuild(T, bdd_type, o, base, slist, inputs,
+                trial, outputs, pos, gc, best_size, room, size);
+        R.tried(!done);
+        if (done && size < best_size) {
+            S.swap(T);
+            std::swap(sched, trial);
+            sched->attach(S);
+            kept.save(base, slist);
+            best = o;
+            best_size = size;
+        }
+        T.free_forest();
+    }
+    delete trial;
+    kept.restore(base, slist, inputs);
+
+    const bool changed = (best != ordering);
+    rtime.note_time();
+    R.reordered(before, best_size, changed, rtime.get_last_seconds());
+
+    std::cerr << "Reordered after " << pos << " gates: " << before << " -> "
+              << best_size << " live nodes, ordering " << order_switch(best) << "\n";
+    ordering = best;
+    return changed;
+}
+
 /*
  *  Some information showing
  */
@@ -290,6 +609,485 @@ void show_edge(rexdd_edge_t ans)
     printf("\ttarget is %s%llu\t", rexdd_is_terminal(ans.target)?"T":"", rexdd_is_terminal(ans.target)? rexdd_terminal_value(ans.target): ans.target);
 }
 
+/*
+ * What to build in each forest, and how; each forest gets a copy
+ */
+struct build_options {
+    int outputs;            // -p: how many outputs to build; 0: all
+    bool is_gc;
+    gc_policy gc;
+    bool is_reorder;
+    reorder_policy reord;
+    unsigned ordering;
+    bool have_weights;
+    unsigned out_order;
+    bool is_history;
+    bool display;
+    bool funcheck;
+    bool show_card;
+    double time_limit;      // -T: seconds per forest; 0: none
+    uint64_t node_limit;    // -M: unique table entries per forest; 0: none
+    unsigned part;          // which output partition (-w), from 0
+    unsigned parts;         // how many; 1: all outputs in one forest
+    bool quiet;             // no summary; the results table has it (-k)
+    stats_writer* stats;    // -X: machine readable records, or null
+};
+
+/*
+ * The parsed and levelised netlist, shared by every forest
+ */
+struct netlist {
+    std::string model;
+    symbol* slist;
+    symbol** inputs;                // by level
+    unsigned num_vars;
+    unsigned num_outs;
+    std::vector<symbol*> base;      // inputs in file order, for -r and -C
+    double parse_seconds;           // lexing and parsing, or loading the cache
+    double prep_seconds;            // weights, levels, output order, schedules
+};
+
+/*
+ * One forest's line in the results table
+ */
+struct build_result {
+    std::string name;       // type, and partition if any
+    const char* status;     // "done", or the limit that stopped the build
+    unsigned built;         // outputs
+    uint64_t peak;
+    uint64_t nodes;
+    double seconds;
+    uint64_t ands;
+    uint64_t nots;
+};
+
+/*
+ * Fields every stats record has: which model, forest and partition
+ */
+void describe_run(stats_record &r, const rexdd_forest_t &F,
+        const build_options &opt, const netlist &N)
+{
+    r.set("model", N.model);
+    r.set("type", F.S.type_name);
+    r.set("ordering", order_switch(opt.ordering));
+    r.set("out_order", outputs_switch(opt.out_order));
+    if (opt.parts > 1) {
+        r.set("partition", std::to_string(opt.part+1) + "/" + std::to_string(opt.parts));
+    }
+}
+
+/*
+ * Build the scheduled outputs into S, as a forest of type bdd_type,
+ * then write the summary to log (or the history file) and free
+ * the forest.  If S has a forest already, it was started by the
+ * streaming builder B, and rtime has been running since parsing.
+ * Gives up early, after the gate that reaches a limit in opt.
+ */
+void build_forest(build_state &S, build_schedule* &sched, char bdd_type,
+        build_options opt, netlist &N, const gate_builder* B,
+        timer* rtime, std::ostream &log, build_result &res)
+{
+    PHASE("build");
+    rexdd_forest_t &F = S.F;
+    if (!S.hasForest()) S.init_forest(bdd_type, N.num_vars);
+    if (!opt.quiet) {
+        log << "Forest level is : " << F.S.num_levels << "\n";
+        log << "Forest type is: " << F.S.type_name << "\n";
+    }
+
+    // Following used for trace the building process, flag setting TBD
+    // clean the existed operation calls files
+    std::string calls_fileName = F.S.type_name;
+    calls_fileName += "operationCalls_Sum.txt";
+    FILE* calls_file = fopen(calls_fileName.c_str(), "r");
+    if (calls_file) {
+        // it exists, empty it
+        fclose(calls_file);
+        calls_file = fopen(calls_fileName.c_str(), "w+");
+        fclose(calls_file);
+    }
+    calls_fileName = F.S.type_name;
+    calls_fileName += "operationCalls_Prod.txt";
+    calls_file = fopen(calls_fileName.c_str(), "r");
+    if (calls_file) {
+        // it exists, empty it
+        fclose(calls_file);
+        calls_file = fopen(calls_fileName.c_str(), "w+");
+        fclose(calls_file);
+    }
+
+    //
+    //  Build BDD for .inputs
+    //
+    const unsigned num_vars = N.num_vars;
+    {
+        PHASE("inputs");
+        for (unsigned i=1; i<=num_vars; i++) {
+            if (S.computed(N.inputs[i])) continue;
+            S.build_input(N.inputs[i]);
+        }
+    }
+
+    //
+    //  Build BDD from outputs
+    //
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point deadline = clock::now() +
+        std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(opt.time_limit));
+    const char* stopped = nullptr;
+    rexdd_edge_t out_dd[N.num_outs+1];
+    unsigned out_idx = 0;
+    uint64_t peak_num = 0;
+    uint64_t pre_ANDs = 0, pre_AND_CTs = 0, pre_NOTs = 0, pre_NOT_CTs = 0, pre_peak = 0;
+    timer own_time;
+    if (nullptr == rtime) rtime = &own_time;
+    for (unsigned k=0; k<sched->numOutputs() && !stopped; k++) {
+        symbol* p = sched->output(k);
+        // std::cerr << "building " << p->name << "...\n";
+        timer intime;
+        for (unsigned i=sched->begin(k); i<sched->end(k); i++) {
+            S.build(sched->gate(i));
+            sched->built(i);
+            if (F.UT->num_entries > peak_num) peak_num = F.UT->num_entries;
+            if (opt.is_gc && opt.gc.due(F)) {
+                timer gctime;
+                const uint64_t before = F.UT->num_entries;
+                S.collect_garbage();
+                gctime.note_time();
+                opt.gc.collected(before, F, gctime.get_last_seconds());
+
+                if (opt.is_reorder && opt.reord.due(F) &&
+                    reorder(S, bdd_type, opt.ordering, opt.have_weights, N.base,
+                            N.slist, N.inputs, sched, opt.outputs, i+1,
+                            opt.gc, opt.node_limit, opt.reord))
+                {
+                    // earlier outputs are in the new forest now; its
+                    // counters include the trial, which is not this output's
+                    for (unsigned j=0; j<out_idx; j++) {
+                        out_dd[j] = S.dd(sched->output(j));
+                    }
+                    pre_ANDs = F.num_ops;
+                    pre_AND_CTs = F.ct_hits;
+                    pre_NOTs = F.num_nots;
+                    pre_NOT_CTs = F.ct_hits_nots;
+                }
+            }
+            if (opt.node_limit && F.UT->num_entries > opt.node_limit) {
+                stopped = "nodes";
+                break;
+            }
+            if (opt.time_limit && clock::now() > deadline) {
+                stopped = "time";
+                break;
+            }
+        }
+        if (stopped) break;
+        const rexdd_edge_t &dd = S.dd(p);
+        out_dd[out_idx] = dd;
+        out_idx++;
+        if (opt.display || opt.stats) {
+            PHASE("output stats");
+            const unsigned level = rexdd_is_terminal(dd.target) ? 0 :
+                rexdd_unpack_level(rexdd_get_packed_for_handle(F.M, dd.target));
+            if (opt.display) {
+                std::cerr << "\t" << p->name << ":\n";
+                show_edge(dd);
+                printf("level is %d\n", level);
+                if (opt.show_card) {
+                    rexdd_edge_t e = dd;
+                    long long card = card_edge(&F, &e, F.S.num_levels);
+                    std::cerr << "card is: " << card << "\n";
+                }
+            }
+            uint64_t num_nodes;
+            std::unordered_set<rexdd_node_handle_t> seen;
+            num_nodes = count_nodes(&F, dd, seen);
+            const uint64_t ut_now = F.UT->num_entries;
+            intime.note_time();
+            if (opt.display) {
+                std::cerr << "number of nodes: \t" << num_nodes << "\n";
+                std::cerr << "peak nodes: \t" << ut_now << "\n";
+                std::cerr << "inc nodes: \t";
+                if (ut_now >= pre_peak) {
+                    std::cerr << ut_now - pre_peak << "\n";
+                } else {
+                    std::cerr << "-" << pre_peak - ut_now << "\n";
+                }
+                std::cerr << "AND calls: \t" << F.num_ops-pre_ANDs << "\n";
+                std::cerr << "AND CT hits: \t" << F.ct_hits-pre_AND_CTs << "\n";
+                std::cerr << "NOT calls: \t" << F.num_nots-pre_NOTs << "\n";
+                std::cerr << "NOT CT hits: \t" << F.ct_hits_nots - pre_NOT_CTs << "\n";
+                std::cerr << "Time interval: \t" << intime.get_last_seconds() << " seconds\n";
+            }
+            if (opt.stats) {
+                stats_record r("output");
+                describe_run(r, F, opt, N);
+                r.set("output", p->name);
+                r.set("index", uint64_t(out_idx));
+                r.set("level", uint64_t(level));
+                r.set("nodes", num_nodes);
+                r.set("ut_nodes", ut_now);
+                r.set("inc_nodes", int64_t(ut_now) - int64_t(pre_peak));
+                r.set("and_calls", uint64_t(F.num_ops-pre_ANDs));
+                r.set("and_ct_hits", uint64_t(F.ct_hits-pre_AND_CTs));
+                r.set("not_calls", uint64_t(F.num_nots-pre_NOTs));
+                r.set("not_ct_hits", uint64_t(F.ct_hits_nots-pre_NOT_CTs));
+                r.set("seconds", intime.get_last_seconds());
+                opt.stats->write(r);
+            }
+            pre_ANDs = F.num_ops;
+            pre_AND_CTs = F.ct_hits;
+            pre_NOTs = F.num_nots;
+            pre_NOT_CTs = F.ct_hits_nots;
+            pre_peak = ut_now;
+        }
+
+        if (opt.funcheck) {
+            // check the function results
+            FILE* fout;
+            std::string filename = N.model;
+            filename += "_";
+            filename += p->name;
+            filename += "_";
+            filename += F.S.type_name;
+            filename += "functionOut.txt";
+            fout = fopen(filename.c_str(), "w+");
+            bool minterm_eval[num_vars+2];
+            minterm_eval[0] = 0;
+            minterm_eval[num_vars+1] = 0;
+            rexdd_edge_t e = dd;
+             for (uint64_t i=0; i<=0x01LL<<num_vars; i++) {
+                for (unsigned int j=0; j<num_vars; j++) {
+                    minterm_eval[j+1] = i & (0x01LL << j);
+                }
+                fprintf(fout, "%d\n", rexdd_eval(&F, &e, num_vars, minterm_eval));
+            }
+            fclose(fout);
+        }
+
+        // if (p->name == "V138(3)") {
+        //     FILE* fout;
+        //     std::string filename = "out_edge";
+        //     filename += F.S.type_name;
+        //     filename += ".gv";
+        //     fout = fopen(filename.c_str(), "w+");
+        //     build_gv(fout, &F, dd);
+        //     fclose(fout);
+        // }
+    }
+    rtime->note_time();
+
+    //
+    //  counting the number of nodes; shared nodes count once
+    //
+    timer count_time;
+    uint64_t num_nodes = 0;
+    {
+        PHASE("count");
+        std::unordered_set<rexdd_node_handle_t> seen;
+        for (unsigned int i=0; i<out_idx; i++) {
+            num_nodes += count_nodes(&F, out_dd[i], seen);
+        }
+    }
+    count_time.note_time();
+
+    if (opt.stats) {
+        stats_record r("run");
+        describe_run(r, F, opt, N);
+        r.set("status", stopped ? stopped : "done");
+        r.set("inputs", uint64_t(num_vars));
+        r.set("outputs", uint64_t(N.num_outs));
+        r.set("built", uint64_t(out_idx));
+        r.set("peak_nodes", peak_num);
+        r.set("final_nodes", num_nodes);
+        r.set("and_calls", uint64_t(F.num_ops));
+        r.set("and_terms", uint64_t(F.num_terms));
+        r.set("and_ct_hits", uint64_t(F.ct_hits));
+        r.set("not_calls", uint64_t(F.num_nots));
+        r.set("not_ct_hits", uint64_t(F.ct_hits_nots));
+        r.set("ct_mallocs", uint64_t(F.CT->num_entries));
+        r.set("ct_overwrites", uint64_t(F.CT->num_overwrite));
+        r.set("released", uint64_t(sched->numReleased()));
+        if (opt.is_gc) {
+            r.set("gc_runs", uint64_t(opt.gc.numRuns()));
+            r.set("gc_freed", opt.gc.nodesFreed());
+            r.set("gc_seconds", opt.gc.totalSeconds());
+        }
+        r.set("parse_seconds", N.parse_seconds);
+        r.set("prep_seconds", N.prep_seconds);
+        r.set("build_seconds", rtime->get_last_seconds());
+        r.set("count_seconds", count_time.get_last_seconds());
+        r.set("max_rss_kb", max_rss_kb());
+        opt.stats->write(r);
+    }
+
+    if (opt.quiet && !opt.is_history) {
+        // see the results table
+    } else if (!opt.is_history) {
+        log << "========================Final(" << F.S.type_name << ")==========================\n";
+        log << "Model: " << N.model << "\n";
+        log << "Number of inputs: \t" << num_vars << "\n";
+        log << "Number of outputs: \t" << N.num_outs << "\n";
+        if (opt.parts > 1) {
+            log << "Partition: \t\t" << opt.part+1 << " of " << opt.parts
+                << ", " << sched->numOutputs() << " outputs\n";
+        }
+        if (stopped) {
+            log << "Gave up: \t\t" << stopped << " limit, after "
+                << out_idx << " outputs <==\n";
+        }
+        log << "Peak nodes: \t\t" << peak_num << "\n";
+        log << "Released gate roots: \t" << sched->numReleased() << "\n";
+        log << "Final nodes number: \t" << num_nodes << " <==\n";
+        log << "Total running time: \t" << rtime->get_last_seconds() << " seconds <==\n";
+        if (B && B->builtOutput()) {
+            log << "First output after: \t" << B->firstOutputSeconds() << " seconds\n";
+        }
+        log << "Total AND calls: \t" << F.num_ops << "\n";
+        log << "Total AND terminals: \t" << F.num_terms << "\n";
+        log << "Total AND CT hits: \t" << F.ct_hits << "\n";
+        log << "Total NOT calls: \t" << F.num_nots << "\n";
+        log << "Total NOT CT hits: \t" << F.ct_hits_nots << "\n";
+        log << "AND CT hits per call: \t"
+            << (F.num_ops ? double(F.ct_hits) / F.num_ops : 0.0) << "\n";
+        log << "Output order: \t\t" << outputs_switch(opt.out_order) << "\n";
+        log << "Mallocs in CT: \t\t" << F.CT->num_entries << "\n";
+        log << "Overwrites in CT: \t" << F.CT->num_overwrite << "\n";
+        if (opt.is_gc) opt.gc.report(log);
+        S.P.report(log);
+        if (opt.is_reorder) {
+            opt.reord.report(log);
+            log << "Final ordering: \t" << order_switch(opt.ordering) << "\n";
+        }
+    } else {
+        // partitions of a type append to the same file
+        static std::mutex history_lock;
+        std::lock_guard<std::mutex> guard(history_lock);
+        FILE* fout;
+        std::string filename = F.S.type_name;
+        filename += ".txt";
+        fout = fopen(filename.c_str(), "a");
+        fprintf(fout, "Model\t%s\n", N.model.c_str());
+        if (opt.parts > 1) fprintf(fout, "Partition\t%u/%u\n", opt.part+1, opt.parts);
+        fprintf(fout, "Status\t%s\n", stopped ? stopped : "done");
+        fprintf(fout, "Nodes#\t%llu\n", num_nodes);
+        fprintf(fout, "Time\t%f\n", rtime->get_last_seconds());
+        fprintf(fout, "Peak\t%llu\n", peak_num);
+        fprintf(fout, "ANDs\t%llu\n", F.num_ops);
+        fprintf(fout, "AND_terms\t%llu\n", F.num_terms);
+        fprintf(fout, "AND_CTs\t%llu\n", F.ct_hits);
+        fprintf(fout, "NOTs\t%llu\n", F.num_nots);
+        fprintf(fout, "NOT_CTs\t%llu\n", F.ct_hits_nots);
+        fprintf(fout, "AND_CT_per_call\t%f\n", F.num_ops ? double(F.ct_hits) / F.num_ops : 0.0);
+        fprintf(fout, "Out_order\t%s\n", outputs_switch(opt.out_order));
+        fprintf(fout, "CT_mallocs\t%llu\n", F.CT->num_entries);
+        fprintf(fout, "CT_overWs\t%llu\n", F.CT->num_overwrite);
+        if (opt.is_gc) opt.gc.report(fout);
+        S.P.report(fout);
+        if (opt.is_reorder) opt.reord.report(fout);
+        fclose(fout);
+        log << "Done!\n";
+    }
+
+    res.name = F.S.type_name;
+    if (opt.parts > 1) res.name += "/" + std::to_string(opt.part+1);
+    res.status = stopped ? stopped : "done";
+    res.built = out_idx;
+    res.peak = peak_num;
+    res.nodes = num_nodes;
+    res.seconds = rtime->get_last_seconds();
+    res.ands = F.num_ops;
+    res.nots = F.num_nots;
+    S.free_forest();
+}
+
+/*
+ * Add up the partitions of one type, R[first .. first+n), and show
+ * the sums.  Peak and time are the largest partition's, which is
+ * the peak if they ran one after another, and the time if they ran
+ * side by side.  Nodes shared between partitions count once per
+ * partition.
+ */
+build_result merge_results(const std::vector<build_result> &R,
+        unsigned first, unsigned n)
+{
+    build_result all;
+    all.name = R[first].name.substr(0, R[first].name.find('/')) + "/all";
+    all.status = "done";
+    all.built = 0;
+    all.peak = all.nodes = all.ands = all.nots = 0;
+    all.seconds = 0;
+    double cpu = 0;
+    uint64_t peaks = 0;
+    for (unsigned i=first; i<first+n; i++) {
+        if (strcmp("done", R[i].status)) all.status = R[i].status;
+        all.built += R[i].built;
+        all.peak = std::max(all.peak, R[i].peak);
+        peaks += R[i].peak;
+        all.nodes += R[i].nodes;
+        all.ands += R[i].ands;
+        all.nots += R[i].nots;
+        all.seconds = std::max(all.seconds, R[i].seconds);
+        cpu += R[i].seconds;
+    }
+    std::cerr << "========================Merged(" << all.name << ")==========================\n";
+    std::cerr << "Partitions: \t\t" << n << "\n";
+    std::cerr << "Outputs built: \t\t" << all.built << "\n";
+    std::cerr << "Peak nodes (largest): \t" << all.peak << "\n";
+    std::cerr << "Peak nodes (sum): \t" << peaks << "\n";
+    std::cerr << "Final nodes (sum): \t" << all.nodes << " <==\n";
+    std::cerr << "Longest partition: \t" << all.seconds << " seconds <==\n";
+    std::cerr << "All partitions: \t" << cpu << " seconds\n";
+    std::cerr << "Total AND calls: \t" << all.ands << "\n";
+    std::cerr << "Total NOT calls: \t" << all.nots << "\n";
+    return all;
+}
+
+/*
+ * One line per forest, when building several (-t list, -w)
+ */
+void show_results(const std::string &model, const std::vector<build_result> &R)
+{
+    std::cerr << "========================Results(" << model << ")==========================\n";
+    std::cerr << std::left << std::setw(10) << "Type" << std::setw(8) << "Status"
+              << std::right << std::setw(9) << "Outputs" << std::setw(12) << "Peak"
+              << std::setw(12) << "Final" << std::setw(11) << "Time (s)"
+              << std::setw(12) << "ANDs" << std::setw(12) << "NOTs" << "\n";
+    for (unsigned i=0; i<R.size(); i++) {
+        std::cerr << std::left << std::setw(10) << R[i].name
+                  << std::setw(8) << R[i].status << std::right
+                  << std::setw(9) << R[i].built << std::setw(12) << R[i].peak
+                  << std::setw(12) << R[i].nodes << std::setw(11) << R[i].seconds
+                  << std::setw(12) << R[i].ands << std::setw(12) << R[i].nots << "\n";
+    }
+}
+
+/*
+ * Parse the -t argument: a type, a comma separated list of types,
+ * or "all" for every type in typelist() that is not TBD.
+ * Returns false if it makes no sense.
+ */
+bool parse_types(const char* arg, std::vector<char> &types)
+{
+    types.clear();
+    if (0==strcmp("all", arg)) {
+        for (char t=0; t<=11; t++) {
+            if (9 == t || 10 == t) continue;
+            types.push_back(t);
+        }
+        return true;
+    }
+    for (;;) {
+        char* end;
+        const long t = strtol(arg, &end, 10);
+        if (end == arg || t < 0 || t > 11) return false;
+        types.push_back(t);
+        if (0 == *end) return true;
+        if (',' != *end) return false;
+        arg = end+1;
+    }
+}
+
 void typelist()
 {
     std::cerr << "\t\tRexBDD:   0\n";
@@ -321,21 +1119,78 @@ int usage(const char* exe)
     std::cerr << "Switches:\n";
     std::cerr << "    -h: This help\n";
     std::cerr << "\n";
-    std::cerr << "    -t: The BDD type for building (default: RexBDD)\n";
+    std::cerr << "    -t: The BDD type for building (default: RexBDD); a comma\n";
+    std::cerr << "        separated list (e.g. 0,4,8,11), or all, parses once and\n";
+    std::cerr << "        builds each type in its own forest\n";
     typelist();
+    std::cerr << "    -j n: Build up to n types at once, on n threads (default 1);\n";
+    std::cerr << "        they share one process, so one that aborts or runs out\n";
+    std::cerr << "        of memory ends them all\n";
+    std::cerr << "    -w n: Split the outputs into n partitions with little shared\n";
+    std::cerr << "        logic, and build them at once, each on its own thread\n";
+    std::cerr << "        in its own forest; with -k, build n clusters at once\n";
+    std::cerr << "    -k f: Cluster the outputs by fan-in cone: outputs sharing at\n";
+    std::cerr << "        least fraction f of the smaller cone's gates (0 to 1) go\n";
+    std::cerr << "        together.  Clusters are built in their own forests,\n";
+    std::cerr << "        one after another, or -w n at once\n";
+    std::cerr << "    -T secs: Give up on a forest after this many seconds\n";
+    std::cerr << "    -M nodes: Give up on a forest once its unique table\n";
+    std::cerr << "        holds more than this many nodes\n";
     std::cerr << "\n";
     std::cerr << "    -o: The number of outputs to build\n";
     std::cerr << "\n";
     std::cerr << "    -g: Enable garbage collection\n";
+    std::cerr << "    -G min[,growth]: Garbage collect when the unique table\n";
+    std::cerr << "        exceeds min nodes (default 65536), then when it grows\n";
+    std::cerr << "        past growth times what was left (default 2); implies -g\n";
+    std::cerr << "    -r: Reorder when a garbage collection leaves too many nodes,\n";
+    std::cerr << "        by rebuilding under each -o ordering and keeping the\n";
+    std::cerr << "        smallest; implies -g\n";
+    std::cerr << "    -R min[,growth]: Reorder above min live nodes (default\n";
+    std::cerr << "        1048576), then past growth times what was left\n";
+    std::cerr << "        (default 2); implies -r\n";
     std::cerr << "\n";
     std::cerr << "    -f: The histoy results will be writen into file [BDD_name].txt\n";
     std::cerr << "\n";
     std::cerr << "    -d: Display the BDD forest when done\n";
     std::cerr << "\n";
+    std::cerr << "    -Xj file: Append statistics to file as JSON lines, one per\n";
+    std::cerr << "        forest and one per output\n";
+    std::cerr << "    -Xc file: Same, as CSV\n";
+    std::cerr << "\n";
     std::cerr << "    -oF: Order based on file, first .input at TOP\n";
     std::cerr << "    -of: Order based on file, first .input at BOTTOM\n";
     std::cerr << "    -oW: Order by input weights, largest at TOP\n";
     std::cerr << "    -ow: Order by input weights, largest at BOTTOM\n";
+    std::cerr << "    -oD: Order by depth-first fan-in traversal from the outputs,\n";
+    std::cerr << "         deepest fan-in first; first input reached at TOP\n";
+    std::cerr << "    -od: Same, first input reached at BOTTOM\n";
+    std::cerr << "    -oI: As -oD, interleaving the inputs of later outputs; TOP\n";
+    std::cerr << "    -oi: Same, at BOTTOM\n";
+    std::cerr << "    -oL: Order by logic level, longest path to an output at TOP\n";
+    std::cerr << "    -ol: Same, at BOTTOM\n";
+    std::cerr << "\n";
+    std::cerr << "    -Of: Build outputs in file order (default)\n";
+    std::cerr << "    -Od: Build outputs by depth, shallowest first\n";
+    std::cerr << "    -Os: Build outputs by estimated size (support, then cone), smallest first\n";
+    std::cerr << "    -Oc: Build outputs clustered, each after the one it shares most gates with\n";
+    std::cerr << "\n";
+    std::cerr << "    -Fc: Fold sums and products left to right (default)\n";
+    std::cerr << "    -Fb: Fold them as a balanced tree\n";
+    std::cerr << "    -Fs: Fold them smallest first, by node count\n";
+    std::cerr << "    -Fp: Fold them pairwise, sorted by top level\n";
+    std::cerr << "    -Fm: Report the largest intermediate fold result (slow)\n";
+    std::cerr << "    -Fa: Build cubes (products of inputs) with AND calls too\n";
+    std::cerr << "    -Fv: Build covers over inputs (sums of cubes) by splitting\n";
+    std::cerr << "         on the top variable, without OR calls\n";
+    std::cerr << "\n";
+    std::cerr << "    -s: Streaming; build gates on a second thread while parsing\n";
+    std::cerr << "        (needs -oF or -of, and .inputs before the first .names)\n";
+    std::cerr << "\n";
+    std::cerr << "    -C file: Netlist cache; load the parsed and levelised circuit\n";
+    std::cerr << "             from file if it matches the input, otherwise write it\n";
+    std::cerr << "    -Cw file: Same, then stop without building (to parse once\n";
+    std::cerr << "             for several runs)\n";
     std::cerr << "\n";
     std::cerr << "    -L: test BLIF lexer\n";
     std::cerr << "    -P: test BLIF parser\n";
@@ -349,16 +1204,31 @@ int usage(const char* exe)
  *  The main function
  */
 int main(int argc, char** argv) {
-    char bdd_type = 0;      // default RexBDD: 0
+    std::vector<char> types(1, 0);  // default RexBDD: 0
+    unsigned jobs = 1;
+    unsigned workers = 1;
+    double overlap = -1;    // -k: cluster outputs; < 0: don't
+    double time_limit = 0;
+    uint64_t node_limit = 0;
     int outputs = 0;
     bool is_gc = false;
+    gc_policy gc;
+    bool is_reorder = false;
+    reorder_policy reord;
+    fold_policy fold;
     bool is_history = false;
     bool display = false;
     bool funcheck = false;
     bool show_card = false;
     bool testlex = false;
     bool testparse = false;
+    bool streaming = false;
+    const char* cache_file = nullptr;
+    bool cache_only = false;
+    const char* stats_file = nullptr;
+    bool stats_csv = false;
     unsigned ordering = ORDER_WEIGHT_BOT;
+    unsigned out_order = OUTPUTS_FILE;
     if (argc == 1) return usage(argv[0]);
     for (int i=1; i<argc; i++) {
         if (0==strcmp("-h", argv[i])) {
@@ -368,6 +1238,28 @@ int main(int argc, char** argv) {
             is_gc = true;
             continue;
         }
+        if (0==strcmp("-G", argv[i])) {
+            i++;
+            if (i >= argc || !gc.set(argv[i])) return usage(argv[0]);
+            is_gc = true;
+            continue;
+        }
+        if (0==strcmp("-r", argv[i])) {
+            is_reorder = true;
+            is_gc = true;
+            continue;
+        }
+        if (0==strcmp("-R", argv[i])) {
+            i++;
+            if (i >= argc || !reord.set(argv[i])) return usage(argv[0]);
+            is_reorder = true;
+            is_gc = true;
+            continue;
+        }
+        if (0==strncmp("-F", argv[i], 2)) {
+            if (!fold.set(argv[i]+2)) return usage(argv[0]);
+            continue;
+        }
         if (0==strcmp("-f", argv[i])) {
             is_history = true;
             continue;
@@ -386,7 +1278,38 @@ int main(int argc, char** argv) {
         }
         if (0==strcmp("-t", argv[i])) {
             i++;
-            bdd_type = std::stoi(argv[i]);
+            if (i >= argc || !parse_types(argv[i], types)) return usage(argv[0]);
+            continue;
+        }
+        if (0==strcmp("-j", argv[i])) {
+            i++;
+            if (i >= argc || atoi(argv[i]) < 1) return usage(argv[0]);
+            jobs = atoi(argv[i]);
+            continue;
+        }
+        if (0==strcmp("-w", argv[i])) {
+            i++;
+            if (i >= argc || atoi(argv[i]) < 1) return usage(argv[0]);
+            workers = atoi(argv[i]);
+            continue;
+        }
+        if (0==strcmp("-k", argv[i])) {
+            i++;
+            if (i >= argc) return usage(argv[0]);
+            overlap = atof(argv[i]);
+            if (overlap < 0 || overlap > 1) return usage(argv[0]);
+            continue;
+        }
+        if (0==strcmp("-T", argv[i])) {
+            i++;
+            if (i >= argc || atof(argv[i]) <= 0) return usage(argv[0]);
+            time_limit = atof(argv[i]);
+            continue;
+        }
+        if (0==strcmp("-M", argv[i])) {
+            i++;
+            if (i >= argc || strtoull(argv[i], nullptr, 10) < 1) return usage(argv[0]);
+            node_limit = strtoull(argv[i], nullptr, 10);
             continue;
         }
         if (0==strcmp("-p", argv[i])) {
@@ -394,6 +1317,24 @@ int main(int argc, char** argv) {
             outputs = std::stoi(argv[i]);
             continue;
         }
+        if (0==strcmp("-s", argv[i])) {
+            streaming = true;
+            continue;
+        }
+        if (0==strcmp("-C", argv[i]) || 0==strcmp("-Cw", argv[i])) {
+            cache_only = ('w' == argv[i][2]);
+            i++;
+            if (i >= argc) return usage(argv[0]);
+            cache_file = argv[i];
+            continue;
+        }
+        if (0==strcmp("-Xj", argv[i]) || 0==strcmp("-Xc", argv[i])) {
+            stats_csv = ('c' == argv[i][2]);
+            i++;
+            if (i >= argc) return usage(argv[0]);
+            stats_file = argv[i];
+            continue;
+        }
         if (0==strcmp("-L", argv[i])) {
             testlex = true;
             continue;
@@ -402,6 +1343,22 @@ int main(int argc, char** argv) {
             testparse = true;
             continue;
         }
+        if (0==strcmp("-Of", argv[i])) {
+            out_order = OUTPUTS_FILE;
+            continue;
+        }
+        if (0==strcmp("-Od", argv[i])) {
+            out_order = OUTPUTS_DEPTH;
+            continue;
+        }
+        if (0==strcmp("-Os", argv[i])) {
+            out_order = OUTPUTS_SIZE;
+            continue;
+        }
+        if (0==strcmp("-Oc", argv[i])) {
+            out_order = OUTPUTS_CLUSTER;
+            continue;
+        }
         if (0==strcmp("-oF", argv[i])) {
             ordering = ORDER_FILE_TOP;
             continue;
@@ -418,254 +1375,315 @@ int main(int argc, char** argv) {
             ordering = ORDER_WEIGHT_BOT;
             continue;
         }
+        if (0==strcmp("-oD", argv[i])) {
+            ordering = ORDER_DFS_TOP;
+            continue;
+        }
+        if (0==strcmp("-od", argv[i])) {
+            ordering = ORDER_DFS_BOT;
+            continue;
+        }
+        if (0==strcmp("-oI", argv[i])) {
+            ordering = ORDER_INTER_TOP;
+            continue;
+        }
+        if (0==strcmp("-oi", argv[i])) {
+            ordering = ORDER_INTER_BOT;
+            continue;
+        }
+        if (0==strcmp("-oL", argv[i])) {
+            ordering = ORDER_LEVEL_TOP;
+            continue;
+        }
+        if (0==strcmp("-ol", argv[i])) {
+            ordering = ORDER_LEVEL_BOT;
+            continue;
+        }
         return usage(argv[0]);
     }
-    //
-    // Lexer here
-    //
-    lexer L(std::cin);
-    if (testlex) return lextest(L);
-
-    //
-    // Parse input
-    //
-    symbol* slist = 0;
-    try {
-        slist = parse(L);
+    if (streaming && needs_netlist(ordering)) {
+        std::cerr << "Streaming (-s) needs a file ordering, -oF or -of\n";
+        return 1;
     }
-    catch (int c) {
-        return c;
+    if (streaming && is_reorder) {
+        std::cerr << "Streaming (-s) can not be combined with reordering (-r)\n";
+        return 1;
+    }
+    if (types.size() > 1 && (streaming || is_reorder)) {
+        // reordering changes the levels, which every forest shares
+        std::cerr << "Streaming (-s) and reordering (-r) build a single BDD type\n";
+        return 1;
+    }
+    if ((workers > 1 || overlap >= 0) && (streaming || is_reorder)) {
+        std::cerr << "Streaming (-s) and reordering (-r) build all outputs in one forest\n";
+        return 1;
+    }
+    if (jobs > 1 && workers > 1) {
+        std::cerr << "Use either -j (types at once) or -w (partitions at once)\n";
+        return 1;
+    }
+    if ((jobs > 1 || workers > 1) && (display || funcheck)) {
+        std::cerr << "Displaying (-d) and checking (-v) need -j 1 and -w 1\n";
+        return 1;
+    }
+    const bool have_weights = needs_weights(ordering);
+    stats_writer stats;
+    if (stats_file && !stats.open(stats_file, stats_csv)) {
+        std::cerr << "Can't open " << stats_file << " for statistics\n";
+        return 1;
     }
-
     //
-    // Remove inputs from the symbol table, slist
+    // Lexer here; mmaps standard input if it is redirected from a file
     //
-    symbol* inlist = remove_inputs(slist);
+    lexer L(fileno(stdin));
+    if (testlex) return lextest(L);
 
-    if (needs_weights(ordering)) {
-        determine_weights(slist);
-        determine_weights(inlist);
-    }
-    if (testparse) {
-        show_symbols(inlist, slist, ordering);
-        return 0;
-    }
-    unsigned num_vars = determine_levels(inlist, ordering);
-    unsigned num_outs = determine_outputs(slist);
     //
-    // now ready to initialize BDD forest
+    // Symbols and expressions, from the parser or the cache,
+    // all go here and are released together
     //
-    rexdd_forest_t F;
-    rexdd_forest_settings_t s;
-    rexdd_default_forest_settings(num_vars, &s);
-    rexdd_type_setting(&s, bdd_type);
-    rexdd_init_forest(&F, &s);
-    std::cerr << "Forest level is : " << F.S.num_levels << "\n";
-    std::cerr << "Forest type is: " << F.S.type_name << "\n";
+    arena netlist_mem;
+    arena::use netlist_scope(netlist_mem);
 
     //
-    //  Rearrange expressions for variable order
+    // Try the netlist cache first
     //
-    for (symbol* p = slist; p; p=p->next) {
-        if (p->build) {
-            p->build->rearrange();
+    symbol* slist = 0;
+    symbol* inlist = 0;
+    unsigned num_vars = 0;
+    uint64_t source_hash = 0;
+    std::vector<source_file> searched;
+    bool cached = false;
+    netlist N;
+    std::vector<symbol*> &base = N.base;
+    N.parse_seconds = N.prep_seconds = 0;
+    timer phase;
+    if (cache_file && !testparse) {
+        PHASE("cache read");
+        source_hash = content_hash(L.getBuffer(), L.getBufferLength());
+        std::string model;
+        cached = read_cache(cache_file, source_hash, ordering, slist, inlist, model,
+                base);
+        if (cached) {
+            L.setModelName(model);
+            std::cerr << "Loaded model " << model << " from " << cache_file << "\n";
+            for (const symbol* p = inlist; p; p=p->next) ++num_vars;
+            phase.note_time();
+            N.parse_seconds = phase.get_last_seconds();
         }
     }
 
-    // Following used for trace the building process, flag setting TBD
-    // clean the existed operation calls files
-    std::string calls_fileName = F.S.type_name;
-    calls_fileName += "operationCalls_Sum.txt";
-    FILE* calls_file = fopen(calls_fileName.c_str(), "r");
-    if (calls_file) {
-        // it exists, empty it
-        fclose(calls_file);
-        calls_file = fopen(calls_fileName.c_str(), "w+");
-        fclose(calls_file);
-    }
-    calls_fileName = F.S.type_name;
-    calls_fileName += "operationCalls_Prod.txt";
-    calls_file = fopen(calls_fileName.c_str(), "r");
-    if (calls_file) {
-        // it exists, empty it
-        fclose(calls_file);
-        calls_file = fopen(calls_fileName.c_str(), "w+");
-        fclose(calls_file);
-    }
+    std::vector<build_state*> states;
+    gate_builder* B = nullptr;
+    timer* rtime = nullptr;
+    if (!cached) {
+        //
+        // Parse input; when streaming, the builder thread
+        // creates the forest and builds gates as they arrive
+        //
+        if (streaming && !testparse) {
+            rtime = new timer;
+            states.push_back(new build_state(fold));
+            B = new gate_builder(states[0], types[0], ORDER_FILE_TOP == ordering);
+        }
+        try {
+            PHASE("parse");
+            slist = parse(L, B ? B->queue() : nullptr, &searched);
+        }
+        catch (int c) {
+            if (B) B->finish();
+            return c;
+        }
+        if (B && !B->finish()) return 2;
+
+        //
+        // Remove inputs from the symbol table, slist
+        //
+        {
+            PHASE("remove inputs");
+            inlist = remove_inputs(slist);
+        }
+        phase.note_time();
+        N.parse_seconds = phase.get_last_seconds();
 
-    //
-    //  Build BDD for .inputs
-    //
-    symbol** inputs = new symbol* [num_vars+1];
-    store_inputs_by_level(inlist, inputs, num_vars);    // level as index
-    for (unsigned i=1; i<=num_vars; i++) {
-        inputs[i]->dd = build_variable(&F, i);
-        inputs[i]->computed = true;
     }
 
     //
-    //  Build BDD from outputs
+    //  Input weights and levels, output order (-O), partitions (-k, -w),
+    //  then the topological build order, once for all outputs, per forest
+    //  (per partition, with -w).  This also rearranges the shared
+    //  expressions for variable order, so it is done here, before
+    //  any forest is built.
     //
-    rexdd_edge_t out_dd[num_outs+1];
-    unsigned out_idx = 0;
-    uint64_t peak_num = 0;
-    uint64_t pre_ANDs = 0, pre_AND_CTs = 0, pre_NOTs = 0, pre_NOT_CTs = 0, pre_peak = 0;
-    timer* rtime = new timer;
-    for (symbol* p=slist; p; p=p->next) {
-        //
-        if (p->type == OUTPUT) {
-            // std::cerr << "building " << p->name << "...\n";
-            timer* intime = new timer;
-            p->build_bdd(&F);
-            out_dd[out_idx] = p->dd;
-            out_idx++;
-            if (display) {
-                std::cerr << "\t" << p->name << ":\n";
-                show_edge(p->dd);
-                printf("level is %d\n", (rexdd_is_terminal(p->dd.target))?0:rexdd_unpack_level(rexdd_get_packed_for_handle(F.M, p->dd.target)));
-                if (show_card) {
-                    long long card = card_edge(&F, &p->dd, F.S.num_levels);
-                    std::cerr << "card is: " << card << "\n";
-                }
-                uint64_t num_nodes;
-                num_nodes = mark_and_count(&F, &p->dd);
-                std::cerr << "number of nodes: \t" << num_nodes << "\n";
-                peak_num = F.UT->num_entries;
-                std::cerr << "peak nodes: \t" << peak_num << "\n";
-                std::cerr << "inc nodes: \t";
-                if (peak_num >= pre_peak) {
-                    std::cerr << peak_num - pre_peak << "\n";
-                } else {
-                    std::cerr << "-" << pre_peak - peak_num << "\n";
+    struct build_run {
+        unsigned type;          // index into types
+        unsigned part;
+        build_state* S;
+        build_schedule* sched;
+    };
+    std::vector< std::vector<symbol*> > parts(1);
+    build_options opt;
+    std::vector<build_run> runs;
+    try {
+        if (!cached) {
+            if (needs_weights(ordering)) {
+                PHASE("weights");
+                determine_weights(slist);
+                determine_weights(inlist);
+            }
+            if (testparse) {
+                show_symbols(inlist, slist, ordering);
+                return 0;
+            }
+            if (B) {
+                // levels were fixed by the builder, upside down for -oF
+                for (const symbol* p = inlist; p; p=p->next) ++num_vars;
+                inputs_by_level(inlist, base);
+                if (ORDER_FILE_TOP == ordering) {
+                    std::reverse(base.begin(), base.end());
                 }
-                std::cerr << "AND calls: \t" << F.num_ops-pre_ANDs << "\n";
-                std::cerr << "AND CT hits: \t" << F.ct_hits-pre_AND_CTs << "\n";
-                std::cerr << "NOT calls: \t" << F.num_nots-pre_NOTs << "\n";
-                std::cerr << "NOT CT hits: \t" << F.ct_hits_nots - pre_NOT_CTs << "\n";
-                intime->note_time();
-                std::cerr << "Time interval: \t" << intime->get_last_seconds() << " seconds\n";
-                pre_ANDs = F.num_ops;
-                pre_AND_CTs = F.ct_hits;
-                pre_NOTs = F.num_nots;
-                pre_NOT_CTs = F.ct_hits_nots;
-                pre_peak = peak_num;
+            } else {
+                PHASE("levels");
+                inputs_by_level(inlist, base);
+                num_vars = determine_levels(inlist, slist, ordering);
             }
 
-            if (funcheck) {
-                // check the function results
-                FILE* fout;
-                std::string filename = L.getModelName();
-                filename += "_";
-                filename += p->name;
-                filename += "_";
-                filename += F.S.type_name;
-                filename += "functionOut.txt";
-                fout = fopen(filename.c_str(), "w+");
-                bool minterm_eval[num_vars+2];
-                minterm_eval[0] = 0;
-                minterm_eval[num_vars+1] = 0;
-                 for (uint64_t i=0; i<=0x01LL<<num_vars; i++) {
-                    for (unsigned int j=0; j<num_vars; j++) {
-                        minterm_eval[j+1] = i & (0x01LL << j);
-                    }
-                    fprintf(fout, "%d\n", rexdd_eval(&F, &p->dd, num_vars, minterm_eval));
+            if (cache_file) {
+                PHASE("cache write");
+                write_cache(cache_file, source_hash, ordering, slist, inlist,
+                        L.getModelName(), base, searched);
+            }
+        }
+        if (cache_only) return 0;
+        unsigned num_outs = determine_outputs(slist);
+
+        order_outputs(slist, inlist, out_order);
+        if (overlap >= 0) {
+            PHASE("clusters");
+            std::vector<output_cluster> clusters;
+            cluster_outputs(slist, inlist, outputs, overlap, clusters);
+            unsigned big = 0;
+            for (unsigned c=0; c<clusters.size(); c++) {
+                if (clusters[c].gates > clusters[big].gates) big = c;
+            }
+            if (!clusters.empty()) {
+                std::cerr << "Output clusters: " << clusters.size() << "; largest has "
+                          << clusters[big].outputs.size() << " outputs, "
+                          << clusters[big].gates << " gates, "
+                          << clusters[big].support << " inputs\n";
+                parts.clear();
+                for (unsigned c=0; c<clusters.size(); c++) {
+                    parts.push_back(clusters[c].outputs);
                 }
-                fclose(fout);
             }
+        } else if (workers > 1) {
+            PHASE("partition");
+            partition_outputs(slist, inlist, outputs, workers, parts);
+            if (parts.empty()) parts.resize(1);
+        }
+        if (B) {
+            std::cerr << "Streamed " << B->numBuilt() << " gates while parsing\n";
+        }
+
+        N.model = L.getModelName();
+        N.slist = slist;
+        N.inputs = new symbol* [num_vars+1];
+        N.num_vars = num_vars;
+        N.num_outs = num_outs;
+        store_inputs_by_level(inlist, N.inputs, num_vars);    // level as index
 
-            // if (p->name == "V138(3)") {
-            //     FILE* fout;
-            //     std::string filename = "out_edge";
-            //     filename += F.S.type_name;
-            //     filename += ".gv";
-            //     fout = fopen(filename.c_str(), "w+");
-            //     build_gv(fout, &F, p->dd);
-            //     fclose(fout);
-            // }
-            if (is_gc) {
-                // std::cerr << "Garbage collecting...\n";
-                unmark_forest(&F);
-                // mark inputs
-                for (unsigned i=1; i<=num_vars; i++) {
-                    mark_nodes(&F, inputs[i]->dd.target);
+        opt.outputs = outputs;
+        opt.is_gc = is_gc;
+        opt.gc = gc;
+        opt.is_reorder = is_reorder;
+        opt.reord = reord;
+        opt.ordering = ordering;
+        opt.have_weights = have_weights;
+        opt.out_order = out_order;
+        opt.is_history = is_history;
+        opt.display = display;
+        opt.funcheck = funcheck;
+        opt.show_card = show_card;
+        opt.time_limit = time_limit;
+        opt.node_limit = node_limit;
+        opt.part = 0;
+        opt.parts = parts.size();
+        opt.quiet = (overlap >= 0);
+        opt.stats = stats_file ? &stats : nullptr;
+
+        PHASE("schedule");
+        for (unsigned t=0; t<types.size(); t++) {
+            for (unsigned k=0; k<opt.parts; k++) {
+                build_run r;
+                r.type = t;
+                r.part = k;
+                if (runs.size() < states.size()) {
+                    r.S = states[runs.size()];      // streamed
+                } else {
+                    r.S = new build_state(fold);
                 }
-                // mark computed gates or outputs
-                for (symbol* q=slist; q; q=q->next) {
-                    if (q->computed) {
-                        mark_nodes(&F, q->dd.target);
-                    }
+                if (1 == opt.parts) {
+                    r.sched = new build_schedule(slist, outputs, *r.S);
+                } else {
+                    r.sched = new build_schedule(slist, parts[k], *r.S);
                 }
-                //
-                if (F.UT->num_entries > peak_num) peak_num = F.UT->num_entries;
-                rexdd_sweep_UT(F.UT);
-                rexdd_sweep_CT(F.CT, F.M);
-                rexdd_sweep_nodeman(F.M);
+                runs.push_back(r);
             }
-            if (outputs != 0 && out_idx == outputs) break;
         }
     }
-    rtime->note_time();
+    catch (int c) {
+        return c;
+    }
 
     //
-    //  counting the number of nodes
+    //  Build each forest; several at once with -j or -w
     //
-    unmark_forest(&F);
-    if (outputs == 0) {
-        for (unsigned int i=0; i<num_outs; i++) {
-            mark_nodes(&F, out_dd[i].target);
+    phase.note_time();
+    N.prep_seconds = phase.get_last_seconds();
+
+    std::vector<build_result> results(runs.size());
+    const unsigned threads = std::max(jobs, workers);
+    if (threads < 2 || runs.size() < 2) {
+        for (unsigned r=0; r<runs.size(); r++) {
+            build_options ropt = opt;
+            ropt.part = runs[r].part;
+            build_forest(*runs[r].S, runs[r].sched, types[runs[r].type], ropt, N,
+                    B, r ? nullptr : rtime, std::cerr, results[r]);
         }
     } else {
-        for (unsigned int i=0; i<outputs; i++) {
-            mark_nodes(&F, out_dd[i].target);
+        std::atomic<unsigned> next(0);
+        std::mutex report_lock;
+        std::vector<std::thread> pool;
+        for (unsigned j=0; j<threads && j<runs.size(); j++) {
+            pool.push_back(std::thread([&]() {
+                for (;;) {
+                    const unsigned r = next++;
+                    if (r >= runs.size()) return;
+                    build_options ropt = opt;
+                    ropt.part = runs[r].part;
+                    std::ostringstream log;
+                    build_forest(*runs[r].S, runs[r].sched, types[runs[r].type],
+                            ropt, N, nullptr, nullptr, log, results[r]);
+                    std::lock_guard<std::mutex> guard(report_lock);
+                    std::cerr << log.str();
+                }
+            }));
+        }
+        for (unsigned j=0; j<pool.size(); j++) {
+            pool[j].join();
         }
     }
-    uint_fast64_t q, n;
-    uint64_t num_nodes = 0;
-    for (q=0; q<F.M->pages_size; q++) {
-        const rexdd_nodepage_t *page = F.M->pages+q;
-        for (n=0; n<page->first_unalloc; n++) {
-            if (rexdd_is_packed_marked(page->chunk+n)) {
-                num_nodes++;
-            }
-        } // for n
-    } // for p
-    
-    if (!is_history) {
-        std::cerr << "========================Final(" << F.S.type_name << ")==========================\n";
-        std::cerr << "Model: " << L.getModelName() << "\n";
-        std::cerr << "Number of inputs: \t" << num_vars << "\n";
-        std::cerr << "Number of outputs: \t" << num_outs << "\n";
-        std::cerr << "Peak nodes: \t\t" << peak_num << "\n";
-        std::cerr << "Final nodes number: \t" << num_nodes << " <==\n";
-        std::cerr << "Total running time: \t" << rtime->get_last_seconds() << " seconds <==\n";
-        std::cerr << "Total AND calls: \t" << F.num_ops << "\n";
-        std::cerr << "Total AND terminals: \t" << F.num_terms << "\n";
-        std::cerr << "Total AND CT hits: \t" << F.ct_hits << "\n";
-        std::cerr << "Total NOT calls: \t" << F.num_nots << "\n";
-        std::cerr << "Total NOT CT hits: \t" << F.ct_hits_nots << "\n";
-        std::cerr << "Mallocs in CT: \t\t" << F.CT->num_entries << "\n";
-        std::cerr << "Overwrites in CT: \t" << F.CT->num_overwrite << "\n";
-    } else {
-        FILE* fout;
-        std::string filename = F.S.type_name;
-        filename += ".txt";
-        fout = fopen(filename.c_str(), "a");
-        fprintf(fout, "Model\t%s\n", L.getModelName().c_str());
-        fprintf(fout, "Nodes#\t%llu\n", num_nodes);
-        fprintf(fout, "Time\t%f\n", rtime->get_last_seconds());
-        fprintf(fout, "Peak\t%llu\n", peak_num);
-        fprintf(fout, "ANDs\t%llu\n", F.num_ops);
-        fprintf(fout, "AND_terms\t%llu\n", F.num_terms);
-        fprintf(fout, "AND_CTs\t%llu\n", F.ct_hits);
-        fprintf(fout, "NOTs\t%llu\n", F.num_nots);
-        fprintf(fout, "NOT_CTs\t%llu\n", F.ct_hits_nots);
-        fprintf(fout, "CT_mallocs\t%llu\n", F.CT->num_entries);
-        fprintf(fout, "CT_overWs\t%llu\n", F.CT->num_overwrite);
-        fclose(fout);
-        std::cerr << "Done!\n";
+    if (opt.parts > 1) {
+        // each type's partitions, then their sums
+        std::vector<build_result> table;
+        for (unsigned r=0; r<runs.size(); r+=opt.parts) {
+            table.insert(table.end(), results.begin()+r, results.begin()+r+opt.parts);
+            table.push_back(merge_results(results, r, opt.parts));
+        }
+        results.swap(table);
     }
-    
+    if (results.size() > 1) show_results(N.model, results);
+    PHASE_REPORT(std::cerr);
 
-    rexdd_free_forest(&F);
     return 0;
-}
\ No newline at end of file
+}
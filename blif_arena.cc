@@ -0,0 +1,45 @@
+#include "blif_arena.h"
+
+#include <stdlib.h>
+#include <iostream>
+
+thread_local arena* arena::active = nullptr;
+
+arena::arena(size_t chunk_bytes) : chunk_size(chunk_bytes)
+{
+    ptr = nullptr;
+    left = 0;
+    total = 0;
+}
+
+arena::~arena()
+{
+    // newest first, in case later objects refer to earlier ones
+    for (size_t i=finals.size(); i; i--) {
+        finals[i-1].destroy(finals[i-1].obj);
+    }
+    for (size_t i=0; i<chunks.size(); i++) {
+        free(chunks[i]);
+    }
+}
+
+void* arena::refill(size_t bytes)
+{
+    // Oversized requests get a block of their own,
+    // so the rest of the current chunk isn't wasted
+    const bool own = (bytes > chunk_size / 4);
+    const size_t len = own ? bytes : chunk_size;
+
+    char* c = (char*) malloc(len);
+    if (nullptr == c) {
+        std::cerr << "Out of memory (arena)\n";
+        exit(1);
+    }
+    chunks.push_back(c);
+    total += len;
+    if (own) return c;
+
+    ptr = c + bytes;
+    left = chunk_size - bytes;
+    return c;
+}
@@ -0,0 +1,97 @@
+#ifndef BLIF_ARENA_H
+#define BLIF_ARENA_H
+
+#include "defines.h"
+
+#include <vector>
+#include <stddef.h>
+
+/*
+ * Bump allocator for everything the parser builds
+ * (symbols, expressions, list nodes).
+ * Nothing is freed individually; the whole arena goes at once.
+ *
+ * Classes allocated here overload operator new to use the
+ * active arena of the calling thread; see arena::use.
+ */
+class arena {
+        std::vector<char*> chunks;
+        char* ptr;              // next free byte in the current chunk
+        size_t left;            // bytes left in the current chunk
+        const size_t chunk_size;
+        size_t total;           // bytes obtained from malloc
+
+        // Objects whose destructor must still run (e.g., std::string members)
+        struct finalizer {
+            void* obj;
+            void (*destroy)(void*);
+        };
+        std::vector<finalizer> finals;
+
+        static thread_local arena* active;
+    public:
+        arena(size_t chunk_bytes = 1 << 20);
+        ~arena();
+
+        inline void* alloc(size_t bytes) {
+            // keep everything 16-byte aligned
+            bytes = (bytes + 15) & ~size_t(15);
+            if (bytes > left) return refill(bytes);
+            void* p = ptr;
+            ptr += bytes;
+            left -= bytes;
+            return p;
+        }
+
+        /// Allocate room for a T, and run ~T() when the arena goes
+        template <class T>
+        inline void* alloc_final(size_t bytes) {
+            void* p = alloc(bytes);
+            finalizer f;
+            f.obj = p;
+            f.destroy = destroy<T>;
+            finals.push_back(f);
+            return p;
+        }
+
+        /// Total bytes reserved so far
+        inline size_t reserved() const {
+            return total;
+        }
+
+        /// The arena used by this thread
+        static inline arena* current() {
+            ASSERT(active);
+            return active;
+        }
+
+        /*
+         * Make an arena the active one for this thread,
+         * for the lifetime of the use object.
+         */
+        class use {
+                arena* prev;
+            public:
+                use(arena &a) {
+                    prev = active;
+                    active = &a;
+                }
+                ~use() {
+                    active = prev;
+                }
+        };
+
+    private:
+        /// Slow path of alloc(): start a new chunk
+        void* refill(size_t bytes);
+
+        template <class T>
+        static void destroy(void* p) {
+            static_cast<T*>(p)->~T();
+        }
+
+        arena(const arena&) = delete;
+        void operator=(const arena&) = delete;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "blif_build.h"
+#include "blif_phase.h"
+
+#include <utility>
+
+build_state::build_state(const fold_policy &_P) : P(_P)
+{
+    have_forest = false;
+}
+
+build_state::~build_state()
+{
+    free_forest();
+}
+
+void build_state::init_forest(char bdd_type, unsigned num_vars)
+{
+    free_forest();
+    root none;
+    none.computed = false;
+    none.keep_dd = true;
+    roots.assign(symbol::numSlots(), none);
+    rexdd_forest_settings_t s;
+    rexdd_default_forest_settings(num_vars, &s);
+    rexdd_type_setting(&s, bdd_type);
+    rexdd_init_forest(&F, &s);
+    have_forest = true;
+}
+
+void build_state::free_forest()
+{
+    roots.clear();
+    if (!have_forest) return;
+    rexdd_free_forest(&F);
+    have_forest = false;
+}
+
+void build_state::set(const symbol* s, const rexdd_edge_t &e)
+{
+    // symbols created since init_forest() (streaming)
+    if (s->slot >= roots.size()) {
+        root none;
+        none.computed = false;
+        none.keep_dd = true;
+        roots.resize(s->slot+1, none);
+    }
+    roots[s->slot].dd = e;
+    roots[s->slot].computed = true;
+}
+
+void build_state::swap(build_state &B)
+{
+    roots.swap(B.roots);
+    std::swap(have_forest, B.have_forest);
+    std::swap(F, B.F);
+}
+
+bool build_state::release(const symbol* s)
+{
+    ASSERT(s->slot < roots.size());
+    if (!roots[s->slot].keep_dd) return false;
+    roots[s->slot].keep_dd = false;
+    return true;
+}
+
+void build_state::build_input(const symbol* s)
+{
+    set(s, build_variable(&F, s->level));
+}
+
+void build_state::build(const symbol* s)
+{
+    ASSERT(s->build);
+    GATE_TIMED();
+    // std::cerr << "building BDD for " << s->name << " " << s->type << "\n";
+    set(s, s->build->construct(*this));
+}
+
+void build_state::collect_garbage()
+{
+    PHASE("gc");
+    unmark_forest(&F);
+    // inputs, gates still needed, and outputs
+    for (unsigned i=0; i<roots.size(); i++) {
+        if (roots[i].computed && roots[i].keep_dd) {
+            mark_nodes(&F, roots[i].dd.target);
+        }
+    }
+    rexdd_sweep_UT(F.UT);
+    rexdd_sweep_CT(F.CT, F.M);
+    rexdd_sweep_nodeman(F.M);
+}
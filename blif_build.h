@@ -0,0 +1,87 @@
+#ifndef BLIF_BUILD_H
+#define BLIF_BUILD_H
+
+#include "rexdd.h"
+#include "defines.h"
+#include "blif_expr.h"
+#include "blif_fold.h"
+
+#include <vector>
+
+/*
+ * One forest, and what has been built in it so far:
+ * the root edge of each symbol, indexed by symbol::slot.
+ *
+ * The netlist (symbols, expressions, levels) is shared and
+ * read only while building, so one parsed netlist can be built
+ * into several forests, one after another or on several threads.
+ */
+class build_state {
+        struct root {
+            rexdd_edge_t dd;
+            bool computed;
+            // Cleared once every gate using it is built (outputs: never)
+            bool keep_dd;
+        };
+        std::vector<root> roots;
+        bool have_forest;
+    public:
+        rexdd_forest_t F;
+        // How sums and products are folded, with this forest's counters
+        fold_policy P;
+    public:
+        build_state(const fold_policy &P);
+        ~build_state();
+
+        /// Initialize F, forgetting anything built before
+        void init_forest(char bdd_type, unsigned num_vars);
+
+        /// Free F, forgetting anything built
+        void free_forest();
+
+        inline bool hasForest() const { return have_forest; }
+
+        /// Have we computed the BDD root edge of s yet?
+        inline bool computed(const symbol* s) const {
+            return s->slot < roots.size() && roots[s->slot].computed;
+        }
+
+        /// The root edge of s, which must be computed
+        inline const rexdd_edge_t& dd(const symbol* s) const {
+            ASSERT(computed(s));
+            return roots[s->slot].dd;
+        }
+
+        /// Note the root edge of s; it is kept until released
+        void set(const symbol* s, const rexdd_edge_t &e);
+
+        /*
+         * Nothing needs the root edge of s any more, so garbage
+         * collection may take it.  Returns false if it was
+         * released already.
+         */
+        bool release(const symbol* s);
+
+        /// Build the variable for input s, at its level
+        void build_input(const symbol* s);
+
+        /// Build the BDD for gate s; its fan-ins must be computed
+        void build(const symbol* s);
+
+        /// Sweep everything not reachable from a root still kept
+        void collect_garbage();
+
+        /*
+         * Trade forests, and what was built in them, with B;
+         * the fold policies stay.  The forest structs are swapped
+         * as they are, which is fine as long as nothing points
+         * into them (RexDD hands the forest to every call).
+         */
+        void swap(build_state &B);
+
+    private:
+        build_state(const build_state&) = delete;
+        void operator=(const build_state&) = delete;
+};
+
+#endif
@@ -0,0 +1,382 @@
+#include "blif_cache.h"
+#include "blif_expr.h"
+
+#include <vector>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Bump whenever the layout below changes
+#define CACHE_VERSION 4
+
+static const char CACHE_MAGIC[8] = { 'B', 'L', 'I', 'F', 'B', 'D', 'D', 0 };
+
+/*
+ * Layout (all integers little endian):
+ *
+ *      magic[8], version:32, ordering:32, hash:64,
+ *      #searched:32, per .search file: path, hash:64,
+ *      model name, #inputs:32, #symbols:32,
+ *      per symbol (inputs first, in list order):
+ *          name, lineno:32, type:8, level:32, weight:32
+ *      per input, in file order: symbol index:32
+ *      per symbol (same order as above):
+ *          has_build:8, expression (preorder)
+ *
+ *  Strings are length:32 followed by the bytes.
+ *  Expressions are tag:8, flags:8, then
+ *      symbol index:32                 for CACHE_TERM / CACHE_CONST
+ *      #children:32, children          for CACHE_SUM / CACHE_PRODUCT
+ *                                      and CACHE_CHOOSE
+ *      node number:32                  for CACHE_SHARED
+ *  Nodes are numbered from 0 per expression, in the order
+ *  they are finished (children first).
+ */
+
+/*
+ * Bounds-checked reader over the mapped cache file
+ */
+class cache_in {
+        const unsigned char* ptr;
+        const unsigned char* end;
+        bool bad;
+    public:
+        cache_in(const void* buf, size_t len) {
+            ptr = (const unsigned char*) buf;
+            end = ptr + len;
+            bad = false;
+        }
+
+        inline bool ok() const { return !bad; }
+        inline void fail() { bad = true; }
+
+        inline unsigned char get8() {
+            if (ptr >= end) {
+                bad = true;
+                return 0;
+            }
+            return *ptr++;
+        }
+        inline uint32_t get32() {
+            uint32_t x = 0;
+            for (unsigned i=0; i<4; i++) x |= uint32_t(get8()) << (8*i);
+            return x;
+        }
+        inline uint64_t get64() {
+            uint64_t lo = get32();
+            return lo | (uint64_t(get32()) << 32);
+        }
+        inline std::string getstr() {
+            uint32_t len = get32();
+            if (bad || len > size_t(end-ptr)) {
+                bad = true;
+                return "";
+            }
+            std::string s((const char*) ptr, len);
+            ptr += len;
+            return s;
+        }
+};
+
+uint64_t content_hash(const char* buf, size_t len)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<len; i++) {
+        h ^= (unsigned char) buf[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * Hash the current contents of a file, as content_hash();
+ * false if it can't be read
+ */
+static bool hash_file(const std::string &path, uint64_t &h)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return false;
+    }
+    if (0 == st.st_size) {
+        close(fd);
+        h = content_hash("", 0);
+        return true;
+    }
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map) return false;
+    h = content_hash((const char*) map, st.st_size);
+    munmap(map, st.st_size);
+    return true;
+}
+
+/*
+ * Rebuild one expression node into B;
+ * false if the record is malformed
+ */
+static bool load_expr(cache_in &c, const std::vector<symbol*> &syms,
+        expr_builder &B, unsigned &E, std::vector<unsigned> &done)
+{
+    const unsigned char tag = c.get8();
+    const unsigned char flags = c.get8();
+
+    if (CACHE_SHARED == tag) {
+        uint32_t idx = c.get32();
+        if (!c.ok() || idx >= done.size()) return false;
+        E = done[idx];
+        return true;
+    }
+    if (CACHE_TERM == tag || CACHE_CONST == tag) {
+        uint32_t idx = c.get32();
+        if (!c.ok() || idx >= syms.size()) return false;
+        E = B.leaf(syms[idx], (CACHE_CONST == tag) ? expr::CONST : expr::TERM);
+    } else if (CACHE_SUM == tag || CACHE_PRODUCT == tag || CACHE_CHOOSE == tag) {
+        uint32_t n = c.get32();
+        if (CACHE_CHOOSE == tag && 3 != n) return false;
+        std::vector<unsigned> kids;
+        for (uint32_t i=0; c.ok() && i<n; i++) {
+            unsigned k;
+            if (!load_expr(c, syms, B, k, done)) return false;
+            kids.push_back(k);
+        }
+        if (!c.ok()) return false;
+        // lists come out newest first, so go backwards to keep the saved order
+        B.begin();
+        for (unsigned i=kids.size(); i; i--) B.push(kids[i-1]);
+        if (CACHE_CHOOSE == tag)    E = B.end(expr::CHOOSE);
+        else                        E = B.end((CACHE_SUM == tag) ? expr::SUM : expr::PRODUCT);
+    } else {
+        return false;
+    }
+
+    if (flags & 1) B.complement(E);
+    if (flags & 2) B.got_so(E);
+    done.push_back(E);
+    return true;
+}
+
+/*
+ * Check one expression, as load_expr() reads it, without building it;
+ * done counts the nodes finished so far in this expression
+ */
+static bool check_expr(cache_in &c, uint32_t nsyms, unsigned &done)
+{
+    const unsigned char tag = c.get8();
+    c.get8();
+
+    if (CACHE_SHARED == tag) {
+        const uint32_t idx = c.get32();
+        return c.ok() && idx < done;
+    }
+    if (CACHE_TERM == tag || CACHE_CONST == tag) {
+        if (c.get32() >= nsyms) return false;
+    } else if (CACHE_SUM == tag || CACHE_PRODUCT == tag || CACHE_CHOOSE == tag) {
+        const uint32_t n = c.get32();
+        if (CACHE_CHOOSE == tag && 3 != n) return false;
+        for (uint32_t i=0; c.ok() && i<n; i++) {
+            if (!check_expr(c, nsyms, done)) return false;
+        }
+    } else {
+        return false;
+    }
+    done++;
+    return c.ok();
+}
+
+/*
+ * Check everything after the symbol counts: the symbol records
+ * (input levels must be 1..nin, each once), the file order (each
+ * input once) and the expressions; reads to the end of the records
+ */
+static bool check_body(cache_in &c, uint32_t nin, uint32_t nsyms)
+{
+    std::vector<bool> used(nin+1, false);
+    for (uint32_t i=0; c.ok() && i<nsyms; i++) {
+        c.getstr();
+        c.get32();
+        c.get8();
+        const uint32_t lvl = c.get32();
+        c.get32();
+        if (i >= nin) continue;
+        if (0==lvl || lvl > nin || used[lvl]) return false;
+        used[lvl] = true;
+    }
+    std::vector<bool> placed(nin, false);
+    for (uint32_t i=0; c.ok() && i<nin; i++) {
+        const uint32_t k = c.get32();
+        if (k >= nin || placed[k]) return false;
+        placed[k] = true;
+    }
+    for (uint32_t i=0; c.ok() && i<nsyms; i++) {
+        if (0==c.get8()) continue;
+        unsigned done = 0;
+        if (!check_expr(c, nsyms, done)) return false;
+    }
+    return c.ok();
+}
+
+bool read_cache(const char* path, uint64_t hash, unsigned ordering,
+        symbol* &slist, symbol* &inlist, std::string &model,
+        std::vector<symbol*> &file_order)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < 8) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map) return false;
+
+    cache_in c(map, st.st_size);
+    bool fresh = (0==memcmp(map, CACHE_MAGIC, 8));
+    for (unsigned i=0; i<8; i++) c.get8();
+    fresh = fresh && (CACHE_VERSION == c.get32());
+    fresh = fresh && (ordering == c.get32());
+    fresh = fresh && (hash == c.get64());
+    // Files read through .search must be unchanged too
+    const uint32_t nsearched = fresh ? c.get32() : 0;
+    for (uint32_t i=0; fresh && c.ok() && i<nsearched; i++) {
+        const std::string file = c.getstr();
+        const uint64_t saved = c.get64();
+        uint64_t now;
+        if (c.ok() && (!hash_file(file, now) || now != saved)) {
+            std::cerr << file << " changed since the cache was written\n";
+            fresh = false;
+        }
+    }
+    if (!fresh) {
+        munmap(map, st.st_size);
+        std::cerr << "Ignoring stale netlist cache " << path << "\n";
+        return false;
+    }
+
+    std::string mname = c.getstr();
+    const uint32_t nin = c.get32();
+    const uint32_t nsyms = c.get32();
+    if (!c.ok() || nin > nsyms || nsyms > size_t(st.st_size)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    // Check it all before creating anything: a rejected cache
+    // must not leave symbols (and their slots) behind
+    const cache_in body = c;
+    const bool ok = check_body(c, nin, nsyms);
+    c = body;
+    if (!ok) {
+        munmap(map, st.st_size);
+        std::cerr << "Ignoring malformed netlist cache " << path << "\n";
+        return false;
+    }
+
+    std::vector<symbol*> syms(nsyms);
+    for (uint32_t i=0; i<nsyms; i++) {
+        std::string name = c.getstr();
+        unsigned lineno = c.get32();
+        syms[i] = new symbol(name, lineno, nullptr);
+        syms[i]->type = c.get8();
+        syms[i]->level = c.get32();
+        syms[i]->weight = c.get32();
+        syms[i]->id = i;
+    }
+    std::vector<symbol*> order(nin);
+    for (uint32_t i=0; i<nin; i++) {
+        order[i] = syms[c.get32()];
+    }
+    expr_builder B;
+    std::vector<unsigned> done;
+    for (uint32_t i=0; i<nsyms; i++) {
+        if (0==c.get8()) continue;
+        unsigned root;
+        done.clear();
+        load_expr(c, syms, B, root, done);      // checked above
+        syms[i]->set_rhs(syms[i]->lineno, B.finish());
+    }
+    ASSERT(c.ok());
+    munmap(map, st.st_size);
+
+    // Relink lists in saved order
+    for (uint32_t i=0; i+1<nsyms; i++) {
+        syms[i]->next = (i+1 == nin) ? nullptr : syms[i+1];
+    }
+    inlist = nin ? syms[0] : nullptr;
+    slist = (nin < nsyms) ? syms[nin] : nullptr;
+    model = mname;
+    file_order.swap(order);
+    return true;
+}
+
+void write_cache(const char* path, uint64_t hash, unsigned ordering,
+        symbol* slist, symbol* inlist, const std::string &model,
+        const std::vector<symbol*> &file_order,
+        const std::vector<source_file> &searched)
+{
+    unsigned n = 0;
+    unsigned nin = 0;
+    for (symbol* p = inlist; p; p=p->next) {
+        p->id = n++;
+        nin++;
+    }
+    for (symbol* p = slist; p; p=p->next) {
+        p->id = n++;
+    }
+
+    cache_out c;
+    for (unsigned i=0; i<8; i++) c.put8(CACHE_MAGIC[i]);
+    c.put32(CACHE_VERSION);
+    c.put32(ordering);
+    c.put64(hash);
+    c.put32(searched.size());
+    for (unsigned i=0; i<searched.size(); i++) {
+        c.putstr(searched[i].path);
+        c.put64(searched[i].hash);
+    }
+    c.putstr(model);
+    c.put32(nin);
+    c.put32(n);
+
+    for (int pass=0; pass<2; pass++) {
+        for (symbol* p = pass ? slist : inlist; p; p=p->next) {
+            c.putstr(p->name);
+            c.put32(p->lineno);
+            c.put8(p->type);
+            c.put32(p->level);
+            c.put32(p->weight);
+        }
+    }
+    ASSERT(file_order.size() == nin);
+    for (unsigned i=0; i<nin; i++) {
+        c.put32(file_order[i]->id);
+    }
+    for (int pass=0; pass<2; pass++) {
+        for (symbol* p = pass ? slist : inlist; p; p=p->next) {
+            c.put8(p->build ? 1 : 0);
+            if (p->build) p->build->save(c);
+        }
+    }
+
+    // Another run may have the cache mapped; never change it in place
+    const std::string tmp = std::string(path) + ".tmp." + std::to_string(getpid());
+    FILE* fout = fopen(tmp.c_str(), "wb");
+    bool ok = (nullptr != fout);
+    if (ok) {
+        const std::string &d = c.data();
+        ok = (fwrite(d.data(), 1, d.length(), fout) == d.length());
+        ok = (0 == fclose(fout)) && ok;
+    }
+    ok = ok && (0 == rename(tmp.c_str(), path));
+    if (!ok) {
+        unlink(tmp.c_str());
+        std::cerr << "Couldn't write netlist cache " << path << "\n";
+    }
+}
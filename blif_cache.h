@@ -0,0 +1,91 @@
+#ifndef BLIF_CACHE_H
+#define BLIF_CACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+struct symbol;
+
+/*
+ * Compact binary cache of a parsed and levelised netlist,
+ * so repeated runs on the same BLIF file (e.g., one per BDD type)
+ * can skip parse(), determine_weights() and determine_levels().
+ *
+ * The cache records a hash of the BLIF source, of every file read
+ * through .search, and the ordering used; if any of these differs,
+ * the cache is stale and is ignored.
+ */
+
+/// Hash of the BLIF source text (FNV-1a, 64 bits)
+uint64_t content_hash(const char* buf, size_t len);
+
+/// A file read through .search, and the content_hash() of its text
+struct source_file {
+    std::string path;
+    uint64_t hash;
+};
+
+/*
+ * Load a netlist from a cache file.
+ *
+ *      @param  path        Cache file name
+ *      @param  hash        content_hash() of the BLIF source
+ *      @param  ordering    Variable ordering wanted
+ *      @param  slist       On success: outputs and gates, as left
+ *                          by remove_inputs() and determine_weights()
+ *      @param  inlist      On success: inputs, with levels set
+ *      @param  model       On success: the model name
+ *      @param  file_order  On success: the inputs, in the order
+ *                          of the .inputs lines (for -r)
+ *
+ *      @return true on success; false if the file is missing,
+ *              stale, or malformed (nothing is changed).
+ */
+bool read_cache(const char* path, uint64_t hash, unsigned ordering,
+        symbol* &slist, symbol* &inlist, std::string &model,
+        std::vector<symbol*> &file_order);
+
+/*
+ * Write a netlist to a cache file; arguments as for read_cache(),
+ * plus the files read through .search, as listed by parse().
+ * Also sets symbol::id for every symbol.
+ */
+void write_cache(const char* path, uint64_t hash, unsigned ordering,
+        symbol* slist, symbol* inlist, const std::string &model,
+        const std::vector<symbol*> &file_order,
+        const std::vector<source_file> &searched);
+
+/*
+ * Byte buffer the expression classes serialize themselves into.
+ */
+class cache_out {
+        std::string buf;
+    public:
+        inline void put8(unsigned char x) { buf.push_back(x); }
+        inline void put32(uint32_t x) {
+            for (unsigned i=0; i<4; i++) put8((x >> (8*i)) & 0xff);
+        }
+        inline void put64(uint64_t x) {
+            put32(x & 0xffffffff);
+            put32(x >> 32);
+        }
+        inline void putstr(const std::string &s) {
+            put32(s.length());
+            buf += s;
+        }
+        inline const std::string& data() const { return buf; }
+};
+
+/*
+ * Expression record tags in the cache
+ */
+const unsigned char CACHE_TERM      = 't';
+const unsigned char CACHE_CONST     = 'c';
+const unsigned char CACHE_SUM       = '+';
+const unsigned char CACHE_PRODUCT   = '*';
+const unsigned char CACHE_CHOOSE    = '?';
+const unsigned char CACHE_SHARED    = '=';     // a node saved already
+
+#endif
@@ -1,17 +1,39 @@
 #include "blif_expr.h"
+#include "blif_cache.h"
+#include "blif_build.h"
 
 /*
  * symble table related functions
  */
+
+std::atomic<unsigned> symbol::num_slots(0);
+
 symbol::symbol(const token& t, symbol* x)
 {
-    name = t.getAttr();
+    name = t.getAttr().str();
     lineno = t.getLine();
     next = x;
+    hashval = 0;
     type = UNSET;
     build = nullptr;
-    computed = false;
+    slot = num_slots++;
     parents = nullptr;
+    weight = 0;
+    id = 0;
+}
+
+symbol::symbol(const std::string &n, unsigned line, symbol* x)
+{
+    name = n;
+    lineno = line;
+    next = x;
+    hashval = 0;
+    type = UNSET;
+    build = nullptr;
+    slot = num_slots++;
+    parents = nullptr;
+    weight = 0;
+    id = 0;
 }
 
 void symbol::init_input(unsigned lvl)
@@ -39,15 +61,6 @@ void symbol::init_latch(bool io)
     }
 }
 
-symbol* symbol::get_nsymbol(unsigned num)
-{
-    symbol* curr = this;
-    for (unsigned i=0; i<num; i++) {
-        curr = curr->next;
-    }
-    return curr;
-}
-
 void symbol::set_rhs(unsigned lineno, expr* rhs)
 {
     if (nullptr == build) {
@@ -78,33 +91,58 @@ void symbol::add_parent(symbol* p)
     parents = front;
 }
 
-symbol* move_to_front(symbol* st, std::string name)
+/*
+ * symbol_table methods
+ */
+
+symbol_table::symbol_table()
+{
+    size = 1024;
+    entries = 0;
+    table = new symbol* [size];
+    for (unsigned i=0; i<size; i++) table[i] = nullptr;
+    front = nullptr;
+}
+
+symbol_table::~symbol_table()
 {
-    if (0==st) return 0;
+    // symbols are still in use after parsing; only drop the buckets
+    delete[] table;
+}
 
-    symbol* prev = 0;
-    symbol* curr = st;
-    while (curr) {
-        if (curr->name == name) break;
-        prev = curr;
-        curr = curr->next;
-    }
-    if (0==curr) return 0; // not found
-    if (prev) {
-        // There's stuff in front of curr;
-        // move curr to front
-        prev->next = curr->next;
-        curr->next = st;
+symbol* symbol_table::find(const strview &name) const
+{
+    const unsigned long h = hash(name.data(), name.length());
+    for (unsigned i = h & (size-1); table[i]; i = (i+1) & (size-1)) {
+        const symbol* s = table[i];
+        if (s->hashval != h) continue;
+        if (s->name.length() != name.length()) continue;
+        if (0==memcmp(s->name.data(), name.data(), name.length())) return table[i];
     }
-    return curr;
+    return nullptr;
+}
+
+symbol* symbol_table::insert(const token& t, const char* suffix)
+{
+    symbol* s = new symbol(t, front);
+    if (suffix) s->name += suffix;
+    link(s);
+    return s;
+}
+
+symbol* symbol_table::insert(const std::string &name, unsigned lineno)
+{
+    symbol* s = new symbol(name, lineno, front);
+    link(s);
+    return s;
 }
 
-symbol* make_symbol_entry(symbol* st, bool lhs, const token& name)
+symbol* symbol_table::make_entry(bool lhs, const token& name)
 {
-    symbol* find = move_to_front(st, name.getAttr());
+    symbol* find = this->find(name.getAttr());
 
     if (nullptr == find) {
-        find = new symbol(name, st);
+        find = insert(name);
         find->init_temp();
     }
     if (lhs && INPUT == find->type) {
@@ -115,6 +153,46 @@ symbol* make_symbol_entry(symbol* st, bool lhs, const token& name)
     return find;
 }
 
+void symbol_table::link(symbol* s)
+{
+    if (2*(entries+1) > size) enlarge();
+
+    s->hashval = hash(s->name.data(), s->name.length());
+    unsigned i = s->hashval & (size-1);
+    while (table[i]) i = (i+1) & (size-1);
+    table[i] = s;
+    entries++;
+
+    front = s;
+}
+
+void symbol_table::enlarge()
+{
+    symbol** old = table;
+    const unsigned oldsize = size;
+    size *= 2;
+    table = new symbol* [size];
+    for (unsigned i=0; i<size; i++) table[i] = nullptr;
+    for (unsigned j=0; j<oldsize; j++) {
+        if (nullptr == old[j]) continue;
+        unsigned i = old[j]->hashval & (size-1);
+        while (table[i]) i = (i+1) & (size-1);
+        table[i] = old[j];
+    }
+    delete[] old;
+}
+
+unsigned long symbol_table::hash(const char* name, unsigned len)
+{
+    // FNV-1a
+    unsigned long h = 14695981039346656037UL;
+    for (unsigned i=0; i<len; i++) {
+        h ^= (unsigned char) name[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
 void show_symbols(char stype, const symbol* st)
 {
     bool printed = false;
@@ -130,278 +208,523 @@ void show_symbols(char stype, const symbol* st)
 /*
  *  expression related functions
  */
-expr::expr()
-{
-    top_level = 0;
-    knows_top_level = false;
-    has_complement = false;
-    knows_complement = false;
+expr::expr(unsigned nodes, unsigned nargs)
+{
+    num_nodes = nodes;
+
+    // One block: pointers first, then words, then bytes
+    const size_t bytes = nodes * sizeof(symbol*)
+                       + (nodes + nodes + 1 + nargs) * sizeof(unsigned)
+                       + nodes * 2;
+    char* mem = (char*) arena::current()->alloc(bytes);
+
+    vars = (symbol**) mem;
+    mem += nodes * sizeof(symbol*);
+    top = (unsigned*) mem;
+    mem += nodes * sizeof(unsigned);
+    first = (unsigned*) mem;
+    mem += (nodes+1) * sizeof(unsigned);
+    args = (unsigned*) mem;
+    mem += nargs * sizeof(unsigned);
+    ops = (unsigned char*) mem;
+    mem += nodes;
+    flags = (unsigned char*) mem;
+}
+
+bool expr::ready(const build_state &S) const
+{
+    // constants depend on nothing
+    for (unsigned i=0; i<num_nodes; i++) {
+        if (TERM == ops[i] && !S.computed(vars[i])) return false;
+    }
+    return true;
 }
 
-expr::~expr()
+rexdd_edge_t expr::construct(build_state &S) const
 {
+    if (CHOOSE == ops[root()]) return compose(S);
+    return construct(S, root());
 }
 
-void expr::rearrange()
-{
-}
-
-rexdd_edge_t expr::complement_if_needed(rexdd_forest_t *F, rexdd_edge_t ans) const
-{
-    //
-    if (!is_complemented()) return ans;
-    return rexdd_NOT_edge(F,&ans,F->S.num_levels);
+/*
+ * Build a sub-model instance: one if-then-else per CHOOSE node,
+ * from the bottom up, so shared nodes are built once.
+ */
+rexdd_edge_t expr::compose(build_state &S) const
+{
+    rexdd_forest_t *F = &S.F;
+    fold_policy &P = S.P;
+    std::vector<rexdd_edge_t> val(num_nodes);
+    std::vector<rexdd_edge_t> neg(num_nodes);
+    std::vector<bool> has_neg(num_nodes, false);
+    rexdd_edge_t t, e;
+    for (unsigned i=0; i<num_nodes; i++) {
+        if (TERM == ops[i]) {
+            val[i] = complement_if_needed(F, i, S.dd(vars[i]));
+            continue;
+        }
+        if (CHOOSE != ops[i]) {
+            ASSERT(0 == numArgs(i));
+            val[i] = build_constant(F, F->S.num_levels, constant(i));
+            continue;
+        }
+        const unsigned s = arg(i, 0);
+        const int hi = constant(arg(i, 1));
+        const int lo = constant(arg(i, 2));
+        if (0 == hi || 1 == lo || (hi < 0 && lo < 0)) {
+            if (!has_neg[s]) {
+                neg[s] = rexdd_NOT_edge(F, &val[s], F->S.num_levels);
+                has_neg[s] = true;
+            }
+        }
+        if (1 == hi && 0 == lo) {
+            val[i] = val[s];
+        } else if (0 == hi && 1 == lo) {
+            val[i] = neg[s];
+        } else if (1 == hi) {
+            val[i] = P.combine(F, true, val[s], val[arg(i, 2)]);
+        } else if (0 == hi) {
+            val[i] = P.combine(F, false, neg[s], val[arg(i, 2)]);
+        } else if (0 == lo) {
+            val[i] = P.combine(F, false, val[s], val[arg(i, 1)]);
+        } else if (1 == lo) {
+            val[i] = P.combine(F, true, neg[s], val[arg(i, 1)]);
+        } else {
+            t = P.combine(F, false, val[s], val[arg(i, 1)]);
+            e = P.combine(F, false, neg[s], val[arg(i, 2)]);
+            val[i] = P.combine(F, true, t, e);
+        }
+        val[i] = complement_if_needed(F, i, val[i]);
+    }
+    return val[root()];
 }
 
 /*
- * term methods
+ * 0 or 1 for a constant node (an empty sum or product);
+ * -1 otherwise
  */
+int expr::constant(unsigned i) const
+{
+    if ((SUM != ops[i] && PRODUCT != ops[i]) || numArgs(i)) return -1;
+    return (PRODUCT == ops[i]) != is_complemented(i);
+}
 
-term::term(symbol *v)
+rexdd_edge_t expr::construct(build_state &S, unsigned i) const
 {
-    var = v;
-    ASSERT(var);
-    is_const = false;
+    rexdd_forest_t *F = &S.F;
+    fold_policy &P = S.P;
+    if (TERM == ops[i] || CONST == ops[i]) {
+        symbol* var = vars[i];
+        if (CONST == ops[i] && !S.computed(var)) {
+            // this is for the constant input, change it to be a constant edge
+            S.set(var, build_constant(F, var->level, (is_complemented(i)?1:0)));
+        }
+        // fan-ins are built first; see build_schedule
+        return complement_if_needed(F, i, S.dd(var));
+    }
+
+    const unsigned* a = args + first[i];
+    const unsigned n = numArgs(i);
+    rexdd_edge_t ans, t;
+    if (0==n) {
+        // empty sum is 0, empty product (all don't cares) is 1
+        ans = build_constant(F, F->S.num_levels, PRODUCT == ops[i]);
+        return complement_if_needed(F, i, ans);
+    }
+    if (n > 1 && SUM == ops[i] && P.direct_covers() && is_cover(i)) {
+        P.new_cover();
+        for (unsigned k=0; k<n; k++) {
+            const unsigned j = a[k];
+            if (TERM == ops[j]) {
+                P.add_literal(vars[j]->level, is_complemented(j));
+            } else {
+                for (unsigned c=0; c<numArgs(j); c++) {
+                    const unsigned x = arg(j, c);
+                    P.add_literal(vars[x]->level, is_complemented(x));
+                }
+            }
+            P.end_cube();
+        }
+        ans = P.cover(F);
+#ifdef DEBUG_COVERS
+        rexdd_edge_t chk = construct(S, a[0]);
+        for (unsigned k=1; k<n; k++) {
+            t = construct(S, a[k]);
+            chk = rexdd_OR_edges(F, &t, &chk, F->S.num_levels);
+        }
+        if (chk.target != ans.target || chk.label.rule != ans.label.rule ||
+            chk.label.complemented != ans.label.complemented ||
+            chk.label.swapped != ans.label.swapped)
+        {
+            std::cerr << "Cover mismatch: ";
+            show(std::cerr, i);
+            std::cerr << "\n";
+        }
+#endif
+        return complement_if_needed(F, i, ans);
+    }
+    if (n > 1 && PRODUCT == ops[i] && P.direct_cubes() && is_cube(i)) {
+        std::vector<fold_policy::literal> &lits = P.literals();
+        for (unsigned k=0; k<n; k++) {
+            lits.push_back(fold_policy::literal(vars[a[k]]->level, is_complemented(a[k])));
+        }
+        ans = P.cube(F, lits);
+#ifdef DEBUG_CUBES
+        rexdd_edge_t chk = construct(S, a[0]);
+        for (unsigned k=1; k<n; k++) {
+            t = construct(S, a[k]);
+            chk = rexdd_AND_edges(F, &t, &chk, F->S.num_levels);
+        }
+        if (chk.target != ans.target || chk.label.rule != ans.label.rule ||
+            chk.label.complemented != ans.label.complemented ||
+            chk.label.swapped != ans.label.swapped)
+        {
+            std::cerr << "Cube mismatch: ";
+            show(std::cerr, i);
+            std::cerr << "\n";
+        }
+#endif
+        return complement_if_needed(F, i, ans);
+    }
+    if (n > 1) P.folding();
+    if (!P.is_chain() && n > 1) {
+        std::vector<rexdd_edge_t> operands(n);
+        for (unsigned k=0; k<n; k++) {
+            operands[k] = construct(S, a[k]);
+        }
+        ans = P.fold(F, SUM == ops[i], operands);
+        return complement_if_needed(F, i, ans);
+    }
+    ans = construct(S, a[0]);
+    for (unsigned k=1; k<n; k++) {
+        t = construct(S, a[k]);
+        ans = P.combine(F, SUM == ops[i], t, ans);
+    }
+    return complement_if_needed(F, i, ans);
 }
 
-bool term::ready() const
+/*
+ * A product of input literals only (no gates, no constants)
+ */
+bool expr::is_cube(unsigned i) const
 {
-    return var->computed;
+    for (unsigned k=0; k<numArgs(i); k++) {
+        const unsigned j = arg(i, k);
+        if (TERM != ops[j]) return false;
+        if (INPUT != vars[j]->type || vars[j]->build) return false;
+    }
+    return true;
 }
 
-rexdd_edge_t term::construct(rexdd_forest_t *F) const
+/*
+ * A sum of input literals and uncomplemented cubes, i.e.,
+ * a .names cover over inputs only
+ */
+bool expr::is_cover(unsigned i) const
 {
-    if (! this->var->computed) {
-        // std::cerr << "Uncomputed symbol in term::construct\n";
-        // throw 5;
-        // std::cerr << "uncomputed symbol term" << var->name << "\n";
-        if (is_const) {
-            // this is for the constant input, change it to be a constant edge
-            var->dd = build_constant(F, var->level, (is_complemented()?1:0));
-            var->computed = true;
-        } else {
-            var->build_bdd(F);
+    for (unsigned k=0; k<numArgs(i); k++) {
+        const unsigned j = arg(i, k);
+        if (TERM == ops[j]) {
+            if (INPUT != vars[j]->type || vars[j]->build) return false;
+            continue;
         }
+        if (PRODUCT != ops[j] || is_complemented(j) || !is_cube(j)) return false;
     }
+    return true;
+}
 
-    return complement_if_needed(F, var->dd);
+rexdd_edge_t expr::complement_if_needed(rexdd_forest_t *F, unsigned i, rexdd_edge_t ans) const
+{
+    //
+    if (!is_complemented(i)) return ans;
+    return rexdd_NOT_edge(F,&ans,F->S.num_levels);
 }
 
-void term::show(std::ostream &s) const
+void expr::show(std::ostream &s) const
 {
-    if (this->is_const) {
-        if (is_complemented()) {
-            s << "1";
-        } else {
-            s << "0";
-        }
+    if (CHOOSE != ops[root()]) {
+        show(s, root());
         return;
     }
-    s << ( var ? var->name : "null");
-    if (is_complemented()) s << "'";
+    // a DAG; one line per node
+    s << "{";
+    for (unsigned i=0; i<num_nodes; i++) {
+        if (CHOOSE != ops[i]) continue;
+        s << " #" << i << "=";
+        show(s, arg(i, 0));
+        for (unsigned k=1; k<3; k++) {
+            s << (1==k ? "?" : ":");
+            const unsigned j = arg(i, k);
+            if (constant(j) >= 0)   s << constant(j);
+            else                    s << "#" << j;
+        }
+        s << ";";
+    }
+    s << " }";
 }
 
-void term::add_parent(symbol* p)
+void expr::show(std::ostream &s, unsigned i) const
 {
-    if (var) var->add_parent(p);
+    if (CONST == ops[i]) {
+        s << (is_complemented(i) ? "1" : "0");
+        return;
+    }
+    if (TERM == ops[i]) {
+        s << ( vars[i] ? vars[i]->name : "null");
+        if (is_complemented(i)) s << "'";
+        return;
+    }
+    const char op = (SUM == ops[i]) ? '+' : '*';
+    s << "(";
+    for (unsigned k=0; k<numArgs(i); k++) {
+        if (k) s << op;
+        show(s, arg(i, k));
+    }
+    s << ")";
+    if (is_complemented(i)) s << "'";
 }
 
-unsigned term::find_top()
+void expr::save(cache_out &c) const
 {
-    if (var->build) return var->build->topLevel();
-    else return var->level;
+    std::vector<unsigned> saved(num_nodes, ~0u);
+    unsigned count = 0;
+    save(c, root(), saved, count);
 }
 
 /*
- * assoc methods
+ * Nodes are numbered as they are finished; a node seen
+ * before (in a CHOOSE DAG) is saved as a reference to that
  */
+void expr::save(cache_out &c, unsigned i, std::vector<unsigned> &saved,
+        unsigned &count) const
+{
+    static const unsigned char tags[] = {
+        CACHE_TERM, CACHE_CONST, CACHE_SUM, CACHE_PRODUCT, CACHE_CHOOSE
+    };
+    if (~0u != saved[i]) {
+        c.put8(CACHE_SHARED);
+        c.put8(0);
+        c.put32(saved[i]);
+        return;
+    }
+    c.put8(tags[ops[i]]);
+    c.put8(flags[i] & (COMPLEMENT | KNOWS_SO));
+    if (TERM == ops[i] || CONST == ops[i]) {
+        c.put32(vars[i]->id);
+    } else {
+        c.put32(numArgs(i));
+        for (unsigned k=0; k<numArgs(i); k++) {
+            save(c, arg(i, k), saved, count);
+        }
+    }
+    saved[i] = count++;
+}
 
-assoc::assoc()
+expr* expr::clone(const std::vector<symbol*> &map) const
 {
-    list = nullptr;
+    expr* e = new expr(num_nodes, first[num_nodes]);
+    for (unsigned i=0; i<num_nodes; i++) {
+        e->ops[i] = ops[i];
+        e->flags[i] = flags[i] & ~KNOWS_TOP;
+        e->vars[i] = vars[i] ? map[vars[i]->id] : nullptr;
+        e->first[i] = first[i];
+    }
+    e->first[num_nodes] = first[num_nodes];
+    for (unsigned k=0; k<first[num_nodes]; k++) {
+        e->args[k] = args[k];
+    }
+    return e;
 }
 
-assoc::~assoc()
+void expr::add_parent(symbol* p)
 {
-    while (list) {
-        node* n = list->next;
-        delete list;
-        list = n;
+    for (unsigned i=0; i<num_nodes; i++) {
+        if (vars[i]) vars[i]->add_parent(p);
     }
 }
 
-void assoc::push(expr* t)
+void expr::fanins(std::vector<symbol*> &out) const
 {
-    list = new node(t, list);
+    if (CHOOSE != ops[root()]) {
+        fanins(out, root());
+        return;
+    }
+    // compose() goes node by node
+    for (unsigned i=0; i<num_nodes; i++) {
+        if (TERM == ops[i]) out.push_back(vars[i]);
+    }
 }
 
-bool assoc::ready() const
+void expr::fanins(std::vector<symbol*> &out, unsigned i) const
 {
-    for (node* ptr = list; ptr; ptr = ptr->next) {
-        if (! ptr->term->ready()) return false;
+    if (TERM == ops[i]) {
+        out.push_back(vars[i]);
+        return;
+    }
+    for (unsigned k=0; k<numArgs(i); k++) {
+        fanins(out, arg(i, k));
     }
-    return true;
 }
 
-void assoc::add_parent(symbol* p)
+unsigned expr::topLevel(unsigned i)
 {
-    for (node* ptr = list; ptr; ptr = ptr->next) {
-        ptr->term->add_parent(p);
+    if (flags[i] & KNOWS_TOP) return top[i];
+
+    unsigned tl = 0;
+    if (TERM == ops[i]) {
+        if (vars[i]->build) tl = vars[i]->build->topLevel();
+        else                tl = vars[i]->level;
+    } else if (CONST != ops[i]) {
+        for (unsigned k=0; k<numArgs(i); k++) {
+            unsigned lvl = topLevel(arg(i, k));
+            if (lvl > tl) tl = lvl;
+        }
+    }
+    top[i] = tl;
+    flags[i] |= KNOWS_TOP;
+    return tl;
+}
+
+void expr::forget_levels()
+{
+    for (unsigned i=0; i<num_nodes; i++) {
+        flags[i] &= ~KNOWS_TOP;
     }
 }
 
-void assoc::rearrange()
+void expr::rearrange()
 {
-    find_top();
+    const unsigned r = root();
+    // CHOOSE operands are positional
+    if (TERM == ops[r] || CONST == ops[r] || CHOOSE == ops[r]) return;
+    topLevel(r);
 
 #ifdef DEBUG_REARRANGE
     std::cerr << "Rearranging; old:\n";
-    for (node* ptr = list; ptr; ptr = ptr->next) {
-        std::cerr << "    " << ptr->term->topLevel() << " : ";
-        ptr->term->show(std::cerr);
+    for (unsigned k=0; k<numArgs(r); k++) {
+        std::cerr << "    " << topLevel(arg(r, k)) << " : ";
+        show(std::cerr, arg(r, k));
         std::cerr << "\n";
     }
 #endif
 
-    list = splitsort(list);
+    splitsort(args + first[r], numArgs(r));
 
 #ifdef DEBUG_REARRANGE
     std::cerr << "Rearranging; new:\n";
-    for (node* ptr = list; ptr; ptr = ptr->next) {
-        std::cerr << "    " << ptr->term->topLevel() << " : ";
-        ptr->term->show(std::cerr);
+    for (unsigned k=0; k<numArgs(r); k++) {
+        std::cerr << "    " << topLevel(arg(r, k)) << " : ";
+        show(std::cerr, arg(r, k));
         std::cerr << "\n";
     }
 #endif
 }
 
-unsigned assoc::find_top()
+void expr::save_arrangement(std::vector<unsigned> &out) const
 {
-    unsigned tl = 0;
-    for (const node* ptr = list; ptr; ptr = ptr->next) {
-        unsigned lvl = ptr->term->topLevel();
-        if (lvl > tl) tl = lvl;
-    }
-    return tl;
+    const unsigned r = root();
+    out.insert(out.end(), args + first[r], args + first[r+1]);
 }
 
-void assoc::showlist(std::ostream &s, char op) const
+void expr::restore_arrangement(const std::vector<unsigned> &in, unsigned &pos)
 {
-    s << "(";
-    bool optor = false;
-    for (const node* ptr = list; ptr; ptr = ptr->next) {
-        if (optor) s << op;
-        ptr->term->show(s);
-        optor = true;
+    const unsigned r = root();
+    ASSERT(pos + numArgs(r) <= in.size());
+    for (unsigned k=first[r]; k<first[r+1]; k++) {
+        args[k] = in[pos++];
     }
-    s << ")";
-    if (is_complemented()) s << "'";
 }
 
-assoc::node* assoc::splitsort(node* in)
+void expr::splitsort(unsigned* a, unsigned n)
 {
-    if (nullptr == in) return in;
-    if (nullptr == in->next) return in;
-
-    unsigned key = in->term->topLevel();
-    node* small = 0;
-    node* mid = 0;
-    node* large = 0;
-    while (in) {
-        node* n = in;
-        in = in->next;
+    if (n < 2) return;
 
-        if (n->term->topLevel() == key) {
-            n->next = mid;
-            mid = n;
-            continue;
-        }
-        if (n->term->topLevel() > key) {
-            n->next = large;
-            large = n;
-            continue;
-        }
-        n->next = small;
-        small = n;
-        continue;
+    //
+    // Partition around the first operand's top level.
+    // Each part is collected newest first.
+    //
+    const std::vector<unsigned> in(a, a+n);
+    const unsigned key = topLevel(in[0]);
+    unsigned ns = 0, nm = 0;
+    for (unsigned k=0; k<n; k++) {
+        const unsigned lvl = topLevel(in[k]);
+        if (lvl < key) ns++;
+        if (lvl == key) nm++;
     }
-
-    mid = append(mid, splitsort(large));
-    return append(splitsort(small), mid);
-}
-
-assoc::node* assoc::append(node* front, node* back)
-{
-    if (nullptr == front) return back;
-    if (nullptr == back) return front;
-
-    // find tail of front
-    node* tail = front;
-    while (tail->next) {
-        tail = tail->next;
+    unsigned s = ns, m = ns+nm, l = n;
+    for (unsigned k=0; k<n; k++) {
+        const unsigned lvl = topLevel(in[k]);
+        if (lvl < key)          a[--s] = in[k];
+        else if (lvl == key)    a[--m] = in[k];
+        else                    a[--l] = in[k];
     }
-    tail->next = back;
-    return front;
+
+    splitsort(a, ns);
+    splitsort(a+ns+nm, n-ns-nm);
 }
 
 /*
- * sum methods
+ * expr_builder methods
  */
 
-sum::sum()
+expr_builder::expr_builder()
 {
 }
 
-rexdd_edge_t sum::construct(rexdd_forest_t *F) const
+unsigned expr_builder::leaf(symbol* v, unsigned char op)
 {
-    bool empty = true;
-    rexdd_edge_t ans, t;
-    for (const node* p=List(); p; p=p->next) {
-        if (empty) {
-            ans = p->term->construct(F);
-            empty = false;
-            continue;
-        }
-        t = p->term->construct(F);
-        ans = rexdd_OR_edges(F, &t, &ans, F->S.num_levels);
-        // decrement something like reference count and remove if zero? TBD
-    }
-    return complement_if_needed(F, ans);
+    ASSERT(v);
+    ops.push_back(op);
+    flags.push_back(0);
+    vars.push_back(v);
+    first.push_back(args.size());
+    return ops.size()-1;
 }
 
-void sum::show(std::ostream &s) const
+unsigned expr_builder::end(unsigned char op)
 {
-    showlist(s, '+');
-}
+    ASSERT(!opened.empty());
+    const unsigned start = opened.back();
+    opened.pop_back();
 
-/*
- * product methods
- */
-
-product::product()
-{
+    ops.push_back(op);
+    flags.push_back(0);
+    vars.push_back(nullptr);
+    first.push_back(args.size());
+    for (unsigned k=pending.size(); k>start; k--) {
+        args.push_back(pending[k-1]);
+    }
+    pending.resize(start);
+    return ops.size()-1;
 }
 
-rexdd_edge_t product::construct(rexdd_forest_t *F) const
+expr* expr_builder::finish()
 {
-    // this->show(std::cerr);
-    bool empty = true;
-    rexdd_edge_t ans, t;
-    for (const node* p=List(); p; p=p->next) {
-        // the first BDD edge
-        if (empty) {
-            ans = p->term->construct(F);
-            empty = false;
-            continue;
-        }
-        t = p->term->construct(F);
-        ans = rexdd_AND_edges(F, &t, &ans, F->S.num_levels);
-        // decrement something like reference count and remove if zero? TBD
+    ASSERT(opened.empty());
+    ASSERT(!ops.empty());
+    const unsigned n = ops.size();
+    expr* e = new expr(n, args.size());
+    for (unsigned i=0; i<n; i++) {
+        e->ops[i] = ops[i];
+        e->flags[i] = flags[i];
+        e->vars[i] = vars[i];
+        e->first[i] = first[i];
     }
-    return complement_if_needed(F, ans);
+    e->first[n] = args.size();
+    for (unsigned k=0; k<args.size(); k++) {
+        e->args[k] = args[k];
+    }
+    clear();
+    return e;
 }
 
-void product::show(std::ostream &s) const
+void expr_builder::clear()
 {
-    showlist(s, '*');
-}
\ No newline at end of file
+    ops.clear();
+    flags.clear();
+    vars.clear();
+    first.clear();
+    args.clear();
+    pending.clear();
+    opened.clear();
+}
@@ -4,30 +4,66 @@
 #include "blif_tk.h"
 #include "rexdd.h"
 #include "defines.h"
+#include "blif_arena.h"
+#include "blif_fold.h"
 
 #include <string.h>
+#include <vector>
+#include <atomic>
 
 struct symbol;
+class cache_out;
+class build_state;
 
 /*
- * Find a symbol with the given name
- * and move it to the front of the list if found.
- * If not found, we return null and the list is unchanged.
+ * Symbol table: open-addressing hash (linear probing) keyed by name,
+ * on top of the symbol list.  The list is in declaration order,
+ * most recently declared first; lookups never reorder it.
  */
-symbol* move_to_front(symbol* st, std::string name);
+class symbol_table {
+        symbol** table;     // hash buckets, size is a power of two
+        unsigned size;
+        unsigned entries;
+        symbol* front;      // symbol list, most recently declared first
+    public:
+        symbol_table();
+        ~symbol_table();
+
+        /// Find a symbol with the given name, or null
+        symbol* find(const strview &name) const;
+
+        /*
+         * Add a new symbol (which must not exist yet) to the front of
+         * the list, named after token t plus an optional suffix.
+         */
+        symbol* insert(const token& t, const char* suffix = nullptr);
+
+        /// As above, for a symbol not read from the input (e.g., .subckt)
+        symbol* insert(const std::string &name, unsigned lineno);
+
+        /*
+         * Build a temp symbol with the given name,
+         * or use existing symbol.
+         *
+         *      @param  lhs     If true, this is on the lhs of =
+         *                      (error for inputs)
+         *      @param  name    Token containing the identifier
+         *
+         *      @return The symbol
+         */
+        symbol* make_entry(bool lhs, const token& name);
+
+        /// Front of the symbol list
+        inline symbol* list() const { return front; }
 
-/*
- * Build a temp symbol with the given name,
- * or use existing symbol.
- *
- *      @param  st      List of symbols
- *      @param  lhs     If true, this is on the lhs of =
- *                      (error for inputs)
- *      @param  name    Token containing the identifier
- *
- *      @return Updated list, with new symbol at the front
- */
-symbol* make_symbol_entry(symbol* st, bool lhs, const token& name);
+    private:
+        void link(symbol* s);
+        void enlarge();
+        static unsigned long hash(const char* name, unsigned len);
+
+        symbol_table(const symbol_table&) = delete;
+        void operator=(const symbol_table&) = delete;
+};
 
 /*
  * Primarily for debugging.
@@ -36,115 +72,158 @@ symbol* make_symbol_entry(symbol* st, bool lhs, const token& name);
 void show_symbols(char stype, const symbol* st);
 
 //
-// Expression class hierarchy; built by parser
+// Expressions; built by parser.
+//
+// Each gate's expression is one flat block: its nodes are stored
+// in postorder (operands before their node, the root last) as
+// parallel arrays, so traversals walk contiguous memory and
+// dispatch on an opcode instead of through virtual calls.
+//
+// Instances of a sub-model (see sub_bdd) are expressions of
+// CHOOSE nodes, whose operands may be shared: a DAG, not a tree.
+// These always have a CHOOSE root, and are built by compose().
 //
 class expr {
-        unsigned top_level;
-        bool knows_top_level;
-        bool has_complement;        // if is_constant, true: constant 1; false: constant 0
-        bool knows_complement;      // used for check single output 1s or 0s
     public:
-        expr();
-        virtual ~expr();
+        // Node opcodes
+        static const unsigned char TERM    = 0;
+        static const unsigned char CONST   = 1;    // var is the gate itself
+        static const unsigned char SUM     = 2;
+        static const unsigned char PRODUCT = 3;
+        static const unsigned char CHOOSE  = 4;    // operands: select, high, low
+
+        // Node flags
+        static const unsigned char COMPLEMENT    = 0x01;    // for constants: 1
+        static const unsigned char KNOWS_SO      = 0x02;    // single output flag seen
+        static const unsigned char KNOWS_TOP     = 0x04;    // top[] is valid
+    private:
+        unsigned num_nodes;
+        unsigned char* ops;
+        unsigned char* flags;
+        unsigned* top;          // cached top level, per node
+        symbol** vars;          // TERM and CONST nodes; null otherwise
+        unsigned* first;        // operands of node i are args[first[i] .. first[i+1])
+        unsigned* args;         // operand node indices
+
+        friend class expr_builder;
+        expr(unsigned nodes, unsigned nargs);
+    public:
+        // Expressions live in the active arena
+        static inline void* operator new(size_t bytes) {
+            return arena::current()->alloc(bytes);
+        }
+        static inline void operator delete(void*) { }
 
-        inline void complement() { has_complement = true; }
-        inline bool is_complemented() const { return has_complement; }
-        inline void got_so() { knows_complement = true; }
-        inline bool knows_complemented() const { return knows_complement; }
+        inline unsigned numNodes() const { return num_nodes; }
+        inline unsigned root() const { return num_nodes-1; }
 
-        /// Ready to construct (dependencies built already)
-        virtual bool ready() const = 0;
+        inline unsigned char op(unsigned i) const { return ops[i]; }
+        inline symbol* var(unsigned i) const { return vars[i]; }
+        inline bool is_complemented(unsigned i) const { return flags[i] & COMPLEMENT; }
+        inline unsigned numArgs(unsigned i) const { return first[i+1]-first[i]; }
+        inline unsigned arg(unsigned i, unsigned k) const { return args[first[i]+k]; }
 
-        /// Build BDD for this expr
-        virtual rexdd_edge_t construct(rexdd_forest_t *F) const = 0;
+        /// Ready to construct in S (dependencies built already)
+        bool ready(const build_state &S) const;
+
+        /// Build BDD for this expr in S; sums and products are folded by S.P
+        rexdd_edge_t construct(build_state &S) const;
 
         /// Display, for debugging
-        virtual void show(std::ostream &s) const = 0;
+        void show(std::ostream &s) const;
+
+        /// Serialize, for the netlist cache
+        void save(cache_out &c) const;
+
+        /*
+         * Deep copy, for .subckt instances.
+         * Variable v becomes map[v->id].
+         */
+        expr* clone(const std::vector<symbol*> &map) const;
 
         inline unsigned topLevel() {
-            if (!knows_top_level) {
-                top_level = find_top();
-                knows_top_level = true;
-            }
-            return top_level;
+            return topLevel(root());
         }
 
-        virtual void add_parent(symbol* p) = 0;
+        void add_parent(symbol* p);
 
-        /// Reorder expression based on top levels
-        virtual void rearrange();
+        /// Append the variables used, in the order construct() uses them
+        void fanins(std::vector<symbol*> &out) const;
 
-        rexdd_edge_t complement_if_needed(rexdd_forest_t *F, rexdd_edge_t ans) const;
+        /// Reorder the root's operands based on top levels
+        void rearrange();
 
-    private:
-        virtual unsigned find_top() = 0;
-};
+        /// Append the root's operands, in their current order, to out
+        void save_arrangement(std::vector<unsigned> &out) const;
 
-class term : public expr {
-        symbol* var;
-        bool is_const;
-    public:
-        term(symbol *v);
+        /*
+         * Put back an order saved by save_arrangement(), from in[pos];
+         * pos moves past it.
+         */
+        void restore_arrangement(const std::vector<unsigned> &in, unsigned &pos);
 
-        inline void constant() { is_const = true; };
-        inline bool is_constant() { return is_const; };
+        /// Input levels changed; drop the cached top levels
+        void forget_levels();
 
-        virtual bool ready() const;
-        virtual rexdd_edge_t construct(rexdd_forest_t *F) const;
-        virtual void show(std::ostream &s) const;
-        virtual void add_parent(symbol* p);
-
-    protected:
-        virtual unsigned find_top();
+    private:
+        unsigned topLevel(unsigned i);
+        rexdd_edge_t construct(build_state &S, unsigned i) const;
+        void show(std::ostream &s, unsigned i) const;
+        void save(cache_out &c, unsigned i, std::vector<unsigned> &saved,
+                unsigned &count) const;
+        void fanins(std::vector<symbol*> &out, unsigned i) const;
+        rexdd_edge_t compose(build_state &S) const;
+        int constant(unsigned i) const;
+        rexdd_edge_t complement_if_needed(rexdd_forest_t *F, unsigned i, rexdd_edge_t ans) const;
+        bool is_cube(unsigned i) const;
+        bool is_cover(unsigned i) const;
+
+        void splitsort(unsigned* a, unsigned n);
 };
 
-
-class assoc : public expr {
-    protected:
-        struct node {
-            expr* term;
-            node* next;
-            node(expr* t, node* n) {
-                term = t;
-                next = n;
-            }
-        };
-    private:
-        node* list;
+/*
+ * Assembles expressions node by node, then copies them
+ * into one flat block.  Reused across gates.
+ *
+ * Operands are collected in open lists, which may nest:
+ *      begin(); push(x); push(y); n = end(expr::SUM);
+ * Lists come out newest first, like a stack.
+ */
+class expr_builder {
+        std::vector<unsigned char> ops;
+        std::vector<unsigned char> flags;
+        std::vector<symbol*> vars;
+        std::vector<unsigned> first;
+        std::vector<unsigned> args;
+
+        std::vector<unsigned> pending;  // operands of open lists
+        std::vector<unsigned> opened;   // where each open list starts in pending
     public:
-        assoc();
-        virtual ~assoc();
+        expr_builder();
 
-        void push(expr* t);
+        /// Discard anything added since the last finish()
+        void clear();
 
-        virtual bool ready() const;
-        virtual void add_parent(symbol* p);
+        /// Add a variable (or constant) node
+        unsigned leaf(symbol* v, unsigned char op = expr::TERM);
 
-        virtual void rearrange();
+        /// Open an operand list
+        inline void begin() { opened.push_back(pending.size()); }
 
-    protected:
-        virtual unsigned find_top();
-        void showlist(std::ostream &s, char op) const;
+        /// Add an operand to the innermost open list
+        inline void push(unsigned node) { pending.push_back(node); }
 
-        const node* List() const { return list; }
+        /// Close the innermost list, as the operands of a new node
+        unsigned end(unsigned char op);
 
-    private:
-        static node* splitsort(node* in);
-        static node* append(node* front, node* back);
-};
+        inline void complement(unsigned node) { flags[node] |= expr::COMPLEMENT; }
+        inline void got_so(unsigned node) { flags[node] |= expr::KNOWS_SO; }
 
-class sum : public assoc {
-    public:
-        sum();
-        virtual rexdd_edge_t construct(rexdd_forest_t *F) const;
-        virtual void show(std::ostream &s) const;
-};
-
-class product : public assoc {
-    public:
-        product();
-        virtual rexdd_edge_t construct(rexdd_forest_t *F) const;
-        virtual void show(std::ostream &s) const;
+        /*
+         * Copy the expression, whose root is the node added last,
+         * into the active arena.
+         */
+        expr* finish();
 };
 
 //
@@ -161,6 +240,11 @@ const char UNSET  = ' ';
 struct symlist {
     symbol* item;
     symlist* next;
+
+    static inline void* operator new(size_t bytes) {
+        return arena::current()->alloc(bytes);
+    }
+    static inline void operator delete(void*) { }
 };
 
 //
@@ -177,54 +261,52 @@ struct symbol {
         unsigned level;
         // Expression to build; for temp/output variables
         expr* build;
-        // Have we computed the BDD root edge yet?
-        bool computed;
-        // Do we need to keep the BDD root edge?
-//        bool keep_dd;     // TBD: add this!
-        // The BDD root edge
-        // bdd_edge dd;            // placeholder so far
-        rexdd_edge_t dd;            // using RexDD lib
+        // Index of the BDD root edge, in each build_state;
+        // fixed when the symbol is created
+        unsigned slot;
 
         // Next symbol in the list
         symbol* next;
+        // Hash of the name, for symbol_table
+        unsigned long hashval;
 
         // List of symbols we appear in RHS of
         symlist* parents;
         // Heuristic: how much does this affect outputs
         unsigned weight;
+        // Scratch index, owned by whoever numbered the symbols last:
+        // the netlist cache, .subckt binding, topological_order()
+        // (so order_dag() and build_schedule).  build_schedule keeps
+        // refs by id, so nothing may renumber between its
+        // construction and the last built().
+        unsigned id;
 
     public: // I know, so is the above
 
         symbol(const token& t, symbol* x);
+        symbol(const std::string &n, unsigned line, symbol* x);
+
+        // Symbols live in the active arena; the name is freed with it
+        static inline void* operator new(size_t bytes) {
+            return arena::current()->alloc_final<symbol>(bytes);
+        }
+        static inline void operator delete(void*) { }
 
         void init_input(unsigned lvl);
         void init_output();
         // latches TBD
         void init_temp();
         void init_latch(bool io);   // io = 1: in
-        // return the nth symbol from the front
-        symbol* get_nsymbol(unsigned num);
         void set_rhs(unsigned lineno, expr* rhs);
         void duplicate_error() const;
 
         void add_parent(symbol* p);
 
-        void build_bdd(rexdd_forest_t *F) {
-            ASSERT(build);
-            // std::cerr << "building BDD for " << name << " " << type << "\n";
-            // build->show(std::cerr);
-            // std::cerr << "\n";
-            dd = build->construct(F);
-            computed = true;
-            // FILE* fout;
-            // std::string filename = name + F->S.type_name;
-            // filename += ".gv";
-            // fout = fopen(filename.c_str(), "w+");
-            // build_gv(fout, F, dd);
-            // fclose(fout);
-            // std::cerr << "card of " << name << ": " << card_edge(F, &dd, F->S.num_levels) << "\n";
-
-        }
+        /// Slots handed out so far; the -s builder thread reads this
+        /// while the parser is still creating symbols
+        static inline unsigned numSlots() { return num_slots.load(); }
+    private:
+        static std::atomic<unsigned> num_slots;
 };
 
 #endif
\ No newline at end of file
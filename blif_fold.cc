@@ -0,0 +1,353 @@
+#include "blif_fold.h"
+#include "defines.h"
+
+#include <algorithm>
+#include <queue>
+
+uint64_t count_nodes(rexdd_forest_t *F, const rexdd_edge_t &e,
+        std::unordered_set<rexdd_node_handle_t> &seen)
+{
+    uint64_t num_nodes = 0;
+    std::vector<rexdd_node_handle_t> stack;
+    if (!rexdd_is_terminal(e.target) && seen.insert(e.target).second) {
+        stack.push_back(e.target);
+    }
+    while (!stack.empty()) {
+        const rexdd_packed_node_t* P = rexdd_get_packed_for_handle(F->M, stack.back());
+        stack.pop_back();
+        num_nodes++;
+
+        const rexdd_node_handle_t lo = rexdd_unpack_low_child(P);
+        const rexdd_node_handle_t hi = rexdd_unpack_high_child(P);
+        if (!rexdd_is_terminal(lo) && seen.insert(lo).second) stack.push_back(lo);
+        if (!rexdd_is_terminal(hi) && seen.insert(hi).second) stack.push_back(hi);
+    }
+    return num_nodes;
+}
+
+/*
+ * fold_policy methods
+ */
+
+fold_policy::fold_policy(unsigned h)
+{
+    how = h;
+    measure = false;
+    direct = true;
+    shannon = false;
+    num_folds = 0;
+    num_ops = 0;
+    num_cubes = 0;
+    num_covers = 0;
+    peak_size = 0;
+    last_size = 0;
+}
+
+bool fold_policy::set(const char* arg)
+{
+    if (0==arg[0] || arg[1]) return false;
+    switch (arg[0]) {
+        case 'c':   how = CHAIN;        return true;
+        case 'b':   how = BALANCED;     return true;
+        case 's':   how = SMALLEST;     return true;
+        case 'p':   how = SUPPORT;      return true;
+        case 'm':   measure = true;     return true;
+        case 'a':   direct = false;     return true;
+        case 'v':   shannon = true;     return true;
+    }
+    return false;
+}
+
+uint64_t fold_policy::size_of(rexdd_forest_t *F, const rexdd_edge_t &e)
+{
+    seen.clear();
+    return count_nodes(F, e, seen);
+}
+
+rexdd_edge_t fold_policy::combine(rexdd_forest_t *F, bool sum,
+        rexdd_edge_t &a, rexdd_edge_t &b)
+{
+    rexdd_edge_t ans;
+    if (sum)    ans = rexdd_OR_edges(F, &a, &b, F->S.num_levels);
+    else        ans = rexdd_AND_edges(F, &a, &b, F->S.num_levels);
+    num_ops++;
+    if (measure || SMALLEST == how) {
+        last_size = size_of(F, ans);
+        if (last_size > peak_size) peak_size = last_size;
+    }
+    return ans;
+}
+
+rexdd_edge_t fold_policy::fold(rexdd_forest_t *F, bool sum,
+        std::vector<rexdd_edge_t> &operands)
+{
+    ASSERT(operands.size());
+    switch (how) {
+        case SMALLEST:
+            return smallest_first(F, sum, operands);
+
+        case SUPPORT:
+            // neighbours by top level share the most variables
+            std::stable_sort(operands.begin(), operands.end(),
+                [F](const rexdd_edge_t &a, const rexdd_edge_t &b) {
+                    const unsigned la = rexdd_is_terminal(a.target) ? 0 :
+                        rexdd_unpack_level(rexdd_get_packed_for_handle(F->M, a.target));
+                    const unsigned lb = rexdd_is_terminal(b.target) ? 0 :
+                        rexdd_unpack_level(rexdd_get_packed_for_handle(F->M, b.target));
+                    return la < lb;
+                }
+            );
+            return pairwise(F, sum, operands);
+
+        default:
+            return pairwise(F, sum, operands);
+    }
+}
+
+/*
+ * Combine neighbours, halving the list each round;
+ * an odd one out waits for the next round.
+ */
+rexdd_edge_t fold_policy::pairwise(rexdd_forest_t *F, bool sum,
+        std::vector<rexdd_edge_t> &operands)
+{
+    unsigned n = operands.size();
+    while (n > 1) {
+        unsigned m = 0;
+        for (unsigned k=0; k+1<n; k+=2) {
+            operands[m++] = combine(F, sum, operands[k+1], operands[k]);
+        }
+        if (n % 2) operands[m++] = operands[n-1];
+        n = m;
+    }
+    return operands[0];
+}
+
+/*
+ * Always combine the two smallest operands; ties go to
+ * the one listed first, so the result is repeatable.
+ */
+rexdd_edge_t fold_policy::smallest_first(rexdd_forest_t *F, bool sum,
+        std::vector<rexdd_edge_t> &operands)
+{
+    typedef std::pair<uint64_t, unsigned> sized;     // nodes, index
+    std::priority_queue<sized, std::vector<sized>, std::greater<sized> > Q;
+    for (unsigned k=0; k<operands.size(); k++) {
+        Q.push(sized(size_of(F, operands[k]), k));
+    }
+    while (Q.size() > 1) {
+        const unsigned a = Q.top().second;
+        Q.pop();
+        const unsigned b = Q.top().second;
+        Q.pop();
+        // the result takes slot a; slot b is done with
+        operands[a] = combine(F, sum, operands[b], operands[a]);
+        Q.push(sized(last_size, a));
+    }
+    return operands[Q.top().second];
+}
+
+rexdd_edge_t fold_policy::cube(rexdd_forest_t *F, std::vector<literal> &lits)
+{
+    ASSERT(lits.size());
+    std::sort(lits.begin(), lits.end());
+    // x twice is x; x and x' is empty
+    unsigned n = 1;
+    for (unsigned k=1; k<lits.size(); k++) {
+        if (lits[k].first != lits[n-1].first) {
+            lits[n++] = lits[k];
+            continue;
+        }
+        if (lits[k].second != lits[n-1].second) {
+            return build_constant(F, F->S.num_levels, 0);
+        }
+    }
+    num_cubes++;
+
+    rexdd_edge_label_t l;
+    l.rule = rexdd_rule_X;
+    l.complemented = 0;
+    l.swapped = 0;
+
+    rexdd_edge_t below = build_constant(F, lits[0].first-1, 1);
+    for (unsigned k=0; k<n; k++) {
+        const unsigned lvl = lits[k].first;
+        const rexdd_edge_t zero = build_constant(F, lvl-1, 0);
+        rexdd_unpacked_node_t p;
+        p.level = lvl;
+        p.edge[0] = lits[k].second ? below : zero;
+        p.edge[1] = lits[k].second ? zero : below;
+        // the edge comes from the next literal's node, or the top
+        const unsigned from = (k+1 < n) ? lits[k+1].first-1 : F->S.num_levels;
+        rexdd_reduce_edge(F, from, l, p, &below);
+    }
+    return below;
+}
+
+rexdd_edge_t fold_policy::cover(rexdd_forest_t *F)
+{
+    num_covers++;
+    //
+    // Cubes with the top literal first.  A repeated literal counts
+    // once; a cube with x and x' is empty, so it is left out.
+    // An empty cube (no literals) covers everything.
+    //
+    work.clear();
+    ends.resize(cover_lits.size());
+    for (unsigned c=0; c+1<rows.size(); c++) {
+        literal* L = cover_lits.data() + rows[c];
+        unsigned len = rows[c+1] - rows[c];
+        if (0==len) return build_constant(F, F->S.num_levels, 1);
+        std::sort(L, L+len, std::greater<literal>());
+        bool empty = false;
+        for (unsigned k=1; k<len; k++) {
+            if (L[k].first != L[k-1].first) continue;
+            if (L[k].second != L[k-1].second) empty = true;
+        }
+        if (empty) continue;
+        for (unsigned k=rows[c]; k<rows[c+1]; k++) {
+            ends[k] = rows[c+1];
+        }
+        work.push_back(rows[c]);
+    }
+
+    rexdd_edge_t ans = cofactor(F, 0, F->S.num_levels);
+    memo.clear();
+    memo_keys.clear();
+    return ans;
+}
+
+/*
+ * The sum of the cubes whose remaining literals start at positions
+ * work[begin ..] (those above cut are satisfied), as an edge from
+ * level cut.  The cofactors are pushed above them on work and
+ * popped again, so work is back as it was on return.
+ */
+rexdd_edge_t fold_policy::cofactor(rexdd_forest_t *F, unsigned begin, unsigned cut)
+{
+    const unsigned end = work.size();
+    if (begin == end) return build_constant(F, cut, 0);
+    if (begin+1 == end) return path(F, work[begin], cut);
+
+    uint64_t h = cut;
+    unsigned top = 0;
+    for (unsigned i=begin; i<end; i++) {
+        h = h * 0x9e3779b97f4a7c15ULL + work[i];
+        if (cover_lits[work[i]].first > top) top = cover_lits[work[i]].first;
+    }
+    h ^= h >> 29;
+    const unsigned len = end - begin;
+    auto range = memo.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        const done &d = it->second;
+        if (d.len != len || memo_keys[d.key + len] != cut) continue;
+        if (std::equal(work.begin()+begin, work.end(), memo_keys.begin()+d.key)) {
+            return d.ans;
+        }
+    }
+
+    //
+    // Split on top; cubes without it go both ways.
+    // A cube with nothing left covers its whole branch.
+    //
+    rexdd_edge_t child[2];
+    for (unsigned b=0; b<2; b++) {
+        bool all = false;
+        for (unsigned i=begin; i<end; i++) {
+            const unsigned k = work[i];
+            const literal &L = cover_lits[k];
+            if (L.first != top) {
+                work.push_back(k);
+                continue;
+            }
+            if (L.second == bool(b)) continue;      // x' is 0 on the high side, x on the low
+            unsigned next = k+1;
+            while (next < ends[k] && cover_lits[next].first == top) next++;
+            if (next == ends[k]) {
+                all = true;
+                break;
+            }
+            work.push_back(next);
+        }
+        if (all) {
+            work.resize(end);
+            child[b] = build_constant(F, top-1, 1);
+        } else {
+            child[b] = cofactor(F, end, top-1);
+            work.resize(end);
+        }
+    }
+
+    rexdd_unpacked_node_t p;
+    p.level = top;
+    p.edge[0] = child[0];
+    p.edge[1] = child[1];
+
+    rexdd_edge_label_t l;
+    l.rule = rexdd_rule_X;
+    l.complemented = 0;
+    l.swapped = 0;
+    rexdd_edge_t ans;
+    rexdd_reduce_edge(F, cut, l, p, &ans);
+
+    done d;
+    d.key = memo_keys.size();
+    d.len = len;
+    d.ans = ans;
+    memo_keys.insert(memo_keys.end(), work.begin()+begin, work.end());
+    memo_keys.push_back(cut);
+    memo.insert(std::make_pair(h, d));
+    return ans;
+}
+
+/*
+ * What is left of one cube, from literal k on, as an edge from
+ * level cut: a single path, built bottom up.
+ */
+rexdd_edge_t fold_policy::path(rexdd_forest_t *F, unsigned k, unsigned cut)
+{
+    rexdd_edge_label_t l;
+    l.rule = rexdd_rule_X;
+    l.complemented = 0;
+    l.swapped = 0;
+
+    unsigned last = ends[k]-1;
+    rexdd_edge_t below = build_constant(F, cover_lits[last].first-1, 1);
+    for (;;) {
+        const literal &L = cover_lits[last];
+        // skip repeats, to the first copy
+        while (last > k && cover_lits[last-1].first == L.first) last--;
+        const rexdd_edge_t zero = build_constant(F, L.first-1, 0);
+        rexdd_unpacked_node_t p;
+        p.level = L.first;
+        p.edge[0] = L.second ? below : zero;
+        p.edge[1] = L.second ? zero : below;
+        const unsigned from = (last > k) ? cover_lits[last-1].first-1 : cut;
+        rexdd_reduce_edge(F, from, l, p, &below);
+        if (last == k) return below;
+        last--;
+    }
+}
+
+void fold_policy::report(std::ostream &s) const
+{
+    static const char* names[] = { "chain", "balanced", "smallest first", "support pairs" };
+    s << "Fold strategy: \t\t" << names[how] << "\n";
+    s << "Fold wide nodes: \t" << num_folds << "\n";
+    s << "Fold operations: \t" << num_ops << "\n";
+    s << "Fold direct cubes: \t" << num_cubes << "\n";
+    s << "Fold direct covers: \t" << num_covers << "\n";
+    if (measure || SMALLEST == how) {
+        s << "Fold peak result: \t" << peak_size << " nodes\n";
+    }
+}
+
+void fold_policy::report(FILE* fout) const
+{
+    fprintf(fout, "Fold_strategy\t%u\n", how);
+    fprintf(fout, "Fold_nodes\t%llu\n", (unsigned long long) num_folds);
+    fprintf(fout, "Fold_ops\t%llu\n", (unsigned long long) num_ops);
+    fprintf(fout, "Fold_cubes\t%llu\n", (unsigned long long) num_cubes);
+    fprintf(fout, "Fold_covers\t%llu\n", (unsigned long long) num_covers);
+    fprintf(fout, "Fold_peak\t%llu\n", (unsigned long long) peak_size);
+}
@@ -0,0 +1,156 @@
+#ifndef BLIF_FOLD_H
+#define BLIF_FOLD_H
+
+#include "rexdd.h"
+
+#include <iostream>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Count the nodes reachable from e that are not in seen yet,
+ * and add them to seen.  Touches only those nodes, so the cost
+ * is proportional to the BDD, not to the whole forest;
+ * the forest's mark bits are left alone.
+ */
+uint64_t count_nodes(rexdd_forest_t *F, const rexdd_edge_t &e,
+        std::unordered_set<rexdd_node_handle_t> &seen);
+
+/*
+ * How sum and product nodes combine their operands (-F),
+ * and how much work that took.
+ *
+ * Wide covers folded left to right build a chain of ever larger
+ * intermediate BDDs; the other strategies combine operands
+ * pairwise so the large ones meet only at the end.
+ */
+class fold_policy {
+    public:
+        static const unsigned CHAIN     = 0;    // left to right
+        static const unsigned BALANCED  = 1;    // pairwise, in rounds
+        static const unsigned SMALLEST  = 2;    // the two smallest, by node count
+        static const unsigned SUPPORT   = 3;    // pairwise, by top level
+        // A cube literal: input level, and true if complemented
+        typedef std::pair<unsigned, bool> literal;
+    private:
+        unsigned how;
+        bool measure;               // size every intermediate result
+        bool direct;                // build cubes without AND calls
+        bool shannon;               // build covers without OR calls
+        std::vector<literal> lits;  // scratch for cubes
+
+        // Scratch for covers: cube c is cover_lits[rows[c] .. rows[c+1])
+        std::vector<literal> cover_lits;
+        std::vector<unsigned> rows;
+        std::vector<unsigned> ends;     // for each literal, where its cube ends
+        // Sub-covers, as where each cube's remaining literals start;
+        // a stack, see cofactor()
+        std::vector<unsigned> work;
+        // Sub-covers done, by hash: where the key is in memo_keys
+        // (literal positions, then the level they hang from), and the result
+        struct done {
+            unsigned key;
+            unsigned len;
+            rexdd_edge_t ans;
+        };
+        std::unordered_multimap<uint64_t, done> memo;
+        std::vector<unsigned> memo_keys;
+
+        // What happened, for the statistics
+        uint64_t num_folds;         // sums and products with 2+ operands
+        uint64_t num_ops;           // AND and OR calls
+        uint64_t num_cubes;         // products built directly
+        uint64_t num_covers;        // sums of cubes built directly
+        uint64_t peak_size;         // largest intermediate measured, in nodes
+        uint64_t last_size;         // of the last combine()
+        std::unordered_set<rexdd_node_handle_t> seen;
+    public:
+        fold_policy(unsigned how = CHAIN);
+
+        inline unsigned strategy() const { return how; }
+        inline bool is_chain() const { return CHAIN == how; }
+
+        /*
+         * Parse the switch suffix: c, b, s or p for the strategy,
+         * m to measure every intermediate result (costs a traversal
+         * each; smallest first measures anyway), a to build cubes
+         * with AND calls like any other product, v to build covers
+         * with cover() instead of OR calls.
+         * Returns false if it makes no sense.
+         */
+        bool set(const char* arg);
+
+        /// Combine two operands, and note the result's size
+        rexdd_edge_t combine(rexdd_forest_t *F, bool sum,
+                rexdd_edge_t &a, rexdd_edge_t &b);
+
+        /*
+         * Combine all operands, by any strategy but CHAIN.
+         * The operand vector is used as scratch.
+         */
+        rexdd_edge_t fold(rexdd_forest_t *F, bool sum,
+                std::vector<rexdd_edge_t> &operands);
+
+        /// Mark the start of a sum or product with 2+ operands
+        inline void folding() { num_folds++; }
+
+        /// Build products of input literals with cube()?
+        inline bool direct_cubes() const { return direct; }
+
+        /// Empty scratch list of literals, for cube()
+        inline std::vector<literal>& literals() {
+            lits.clear();
+            return lits;
+        }
+
+        /*
+         * Build a cube directly: it is a single path, so make one
+         * node per literal, bottom up, with rexdd_reduce_edge().
+         * No AND calls, nothing in the compute table.
+         * The literals are sorted, and may repeat.
+         */
+        rexdd_edge_t cube(rexdd_forest_t *F, std::vector<literal> &lits);
+
+        /// Build sums of cubes with cover()?
+        inline bool direct_covers() const { return shannon; }
+
+        /// Start an empty cover, for cover()
+        inline void new_cover() {
+            cover_lits.clear();
+            rows.assign(1, 0);
+        }
+        inline void add_literal(unsigned level, bool complemented) {
+            cover_lits.push_back(literal(level, complemented));
+        }
+        inline void end_cube() { rows.push_back(cover_lits.size()); }
+
+        /*
+         * Build the sum of the cubes added since new_cover() in one
+         * pass over the cover: split it on its top variable, Shannon
+         * style, recursively.  No per-cube BDDs, no OR calls.
+         */
+        rexdd_edge_t cover(rexdd_forest_t *F);
+
+        inline uint64_t numOps() const { return num_ops; }
+        inline uint64_t peakSize() const { return peak_size; }
+
+        /// Human readable summary
+        void report(std::ostream &s) const;
+
+        /// Same, as tab separated lines for the history file
+        void report(FILE* fout) const;
+
+    private:
+        uint64_t size_of(rexdd_forest_t *F, const rexdd_edge_t &e);
+        rexdd_edge_t pairwise(rexdd_forest_t *F, bool sum,
+                std::vector<rexdd_edge_t> &operands);
+        rexdd_edge_t smallest_first(rexdd_forest_t *F, bool sum,
+                std::vector<rexdd_edge_t> &operands);
+        rexdd_edge_t cofactor(rexdd_forest_t *F, unsigned begin, unsigned cut);
+        rexdd_edge_t path(rexdd_forest_t *F, unsigned k, unsigned cut);
+};
+
+#endif
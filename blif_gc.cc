@@ -0,0 +1,57 @@
+#include "blif_gc.h"
+
+#include <stdio.h>
+
+gc_policy::gc_policy(uint64_t mn, double gr) : nodes(mn, gr)
+{
+    page_limit = 0;         // until we know the initial size
+    num_checks = 0;
+    num_runs = 0;
+    by_pages = 0;
+    nodes_freed = 0;
+    seconds = 0;
+}
+
+bool gc_policy::due(const rexdd_forest_t &F)
+{
+    num_checks++;
+    if (0 == page_limit) page_limit = nodes.grown(F.M->pages_size);
+    if (nodes.exceeded(F.UT->num_entries)) return true;
+    if (F.M->pages_size > page_limit) {
+        by_pages++;
+        return true;
+    }
+    return false;
+}
+
+void gc_policy::collected(uint64_t before, const rexdd_forest_t &F, double secs)
+{
+    const uint64_t after = F.UT->num_entries;
+    num_runs++;
+    if (before > after) nodes_freed += before - after;
+    seconds += secs;
+
+    nodes.reset(after);
+    page_limit = nodes.grown(F.M->pages_size);
+}
+
+void gc_policy::report(std::ostream &s) const
+{
+    s << "GC thresholds: \t\t" << nodes.minimum() << " nodes, growth " << nodes.factor() << "\n";
+    s << "GC checks: \t\t" << num_checks << "\n";
+    s << "GC runs: \t\t" << num_runs << " (" << by_pages << " for node pages)\n";
+    s << "GC nodes freed: \t" << nodes_freed << "\n";
+    s << "GC time: \t\t" << seconds << " seconds\n";
+    s << "GC next limit: \t\t" << nodes.current() << " nodes, " << page_limit << " pages\n";
+}
+
+void gc_policy::report(FILE* fout) const
+{
+    fprintf(fout, "GC_min\t%llu\n", (unsigned long long) nodes.minimum());
+    fprintf(fout, "GC_growth\t%f\n", nodes.factor());
+    fprintf(fout, "GC_checks\t%u\n", num_checks);
+    fprintf(fout, "GC_runs\t%u\n", num_runs);
+    fprintf(fout, "GC_page_runs\t%u\n", by_pages);
+    fprintf(fout, "GC_freed\t%llu\n", (unsigned long long) nodes_freed);
+    fprintf(fout, "GC_time\t%f\n", seconds);
+}
@@ -0,0 +1,64 @@
+#ifndef BLIF_GC_H
+#define BLIF_GC_H
+
+#include "rexdd.h"
+#include "blif_limit.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * When to collect garbage (-g).
+ *
+ * Checked after every gate is built.  A collection is due when
+ * the unique table is past its growth_limit, or the node manager
+ * has grown past page_limit pages.  After a collection both limits
+ * follow what is left; pages by the same growth factor, but at
+ * least one more page.
+ */
+class gc_policy {
+        growth_limit nodes;
+        uint64_t page_limit;
+
+        // What happened, for the statistics
+        unsigned num_checks;
+        unsigned num_runs;
+        unsigned by_pages;          // runs triggered by the node manager
+        uint64_t nodes_freed;
+        double seconds;
+    public:
+        gc_policy(uint64_t min_nodes = 1 << 16, double growth = 2.0);
+
+        /// Thresholds from a switch argument; see growth_limit::set()
+        inline bool set(const char* arg) { return nodes.set(arg); }
+
+        /// A policy with the same thresholds, that has not run yet
+        inline gc_policy restart() const {
+            return gc_policy(nodes.minimum(), nodes.factor());
+        }
+
+        /// Time to collect?
+        bool due(const rexdd_forest_t &F);
+
+        /*
+         * A collection just finished.
+         *
+         *      @param  before  Unique table entries before
+         *      @param  F       Forest, after the sweep
+         *      @param  secs    Time taken
+         */
+        void collected(uint64_t before, const rexdd_forest_t &F, double secs);
+
+        inline unsigned numRuns() const { return num_runs; }
+        inline uint64_t nodesFreed() const { return nodes_freed; }
+        inline double totalSeconds() const { return seconds; }
+
+        /// Human readable summary of the thresholds and decisions
+        void report(std::ostream &s) const;
+
+        /// Same, as tab separated lines for the history file
+        void report(FILE* fout) const;
+};
+
+#endif
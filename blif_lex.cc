@@ -1,7 +1,13 @@
 
 #include "blif_lex.h"
 
-#define MAX_LEXEME 1024
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+// Block size when we have to read instead of mmap
+#define READ_BLOCK (1 << 20)
 
 // #define DEBUG_LEXER
 
@@ -9,24 +15,60 @@
 // ======================================================================
 //
 
-lexer::lexeme::lexeme(unsigned bmax) : bufmax(bmax)
+lexer::lexer(std::istream& fin)
 {
-    buffer = new char[bufmax+1];
+    size_t size = READ_BLOCK;
+    size_t len = 0;
+    char* buf = (char*) malloc(size);
+    for (;;) {
+        len += fin.rdbuf()->sgetn(buf+len, size-len);
+        if (len < size) break;
+        size *= 2;
+        buf = (char*) realloc(buf, size);
+    }
+    buffer = buf;
+    bufend = buf + len;
+    maplen = 0;
+    init();
 }
 
-lexer::lexeme::~lexeme()
+lexer::lexer(int fd)
 {
-    delete[] buffer;
+    maplen = 0;
+    struct stat st;
+    if (0==fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED != map) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            maplen = st.st_size;
+            buffer = (const char*) map;
+            bufend = buffer + maplen;
+            init();
+            return;
+        }
+    }
+    // Pipe, terminal, or mmap failed: read in blocks
+    size_t size = READ_BLOCK;
+    size_t len = 0;
+    char* buf = (char*) malloc(size);
+    for (;;) {
+        ssize_t got = read(fd, buf+len, size-len);
+        if (got <= 0) break;
+        len += got;
+        if (len == size) {
+            size *= 2;
+            buf = (char*) realloc(buf, size);
+        }
+    }
+    buffer = buf;
+    bufend = buf + len;
+    init();
 }
 
-//
-// ======================================================================
-//
-
-lexer::lexer(std::istream& _fin) : fin(_fin), text(MAX_LEXEME)
+void lexer::init()
 {
+    pos = buffer;
     next_tok.lineno = 1;
-    num_inputs = 0;
     num_id = 0;
     cover = 0;
     model_name = "";
@@ -35,6 +77,11 @@ lexer::lexer(std::istream& _fin) : fin(_fin), text(MAX_LEXEME)
 
 lexer::~lexer()
 {
+    if (maplen) {
+        munmap((void*) buffer, maplen);
+    } else {
+        free((void*) buffer);
+    }
 }
 
 void lexer::scan_token()
@@ -43,17 +90,17 @@ void lexer::scan_token()
     // Read from appropriate input stream, the next token
     // into lookaheads[0].
     //
-    next_tok.attribute.clear();
+    next_tok.attribute = strview();
     bool has_backslash = 0;
 
     for (;;) {
-        int c = fin.get();
+        int c = next_char();
         if (EOF == c) {
             next_tok.tokenID = token::END;
             return;
         }
 
-        switch (text.start(c)) {
+        switch (c) {
             //
             // Skip whitespace
             //
@@ -65,9 +112,8 @@ void lexer::scan_token()
                         continue;
             case '\n':
                         ++ next_tok.lineno;
-                        text.finish();
                         next_tok.tokenID = token::NEWLINE;
-                        next_tok.attribute = "\\n";
+                        next_tok.attribute = strview("\\n", 2);
                         if (cover == 'o') return;
                         if (cover == 'i' || cover == 'b') cover = 'c';
                         if (num_id == 1) cover = 'o';
@@ -82,6 +128,15 @@ void lexer::scan_token()
 
             case '.':   return consume_keyword();
 
+            case '=':   if (cover == 'i' || cover == 'b') {
+                            // formal=actual, in .subckt
+                            next_tok.tokenID = token::EQUALS;
+                            next_tok.attribute = strview(pos-1, 1);
+                            return;
+                        }
+                        IllegalChar(c);
+                        continue;
+
             /*
              * Single output cover
              */
@@ -93,9 +148,8 @@ void lexer::scan_token()
                             return consume_cover();
                         } 
                         if (cover == 'o') {
-                            text.finish();
                             next_tok.tokenID = token::SO;
-                            next_tok.attribute = std::string(text.get());
+                            next_tok.attribute = strview(pos-1, 1);
                             cover = 'c';
                             return;
                         }
@@ -118,111 +172,95 @@ void lexer::scan_token()
 void lexer::ignore_comment()
 {
     // We've already consumed the #
-    for (;;) {
-        if ('\n' == fin.peek()) {
-            fin.get();
-            ++next_tok.lineno;
-            return;
-        }
-        if (EOF == fin.get()) {
-            return;
-        }
+    const char* nl = (const char*) memchr(pos, '\n', bufend-pos);
+    if (nl) {
+        pos = nl+1;
+        ++next_tok.lineno;
+    } else {
+        pos = bufend;
     }
 }
 
 void lexer::consume_keyword()
 {
     // We already have the first character.
-    // Build up remaining chars
-    int c;
-    for (;;) {
-        c = fin.peek();
-        if (is_ident_char(c)) {
-            text.append(fin.get());
-            continue;
-        }
-        break;
-    }
-    text.finish();
+    // Keywords are checked directly against the buffer.
+    const char* start = pos-1;
+    skip_ident_chars();
+    const strview kw(start, pos-start);
 
     // Check for keywords
     // Could do a binary search, but there's not very many.
 
-    if (text.matches(".model")) {
+    if (kw == ".model") {
         next_tok.tokenID = token::MODEL;
         cover = 'i';
         return;
     }
-    if (text.matches(".inputs")) {
+    if (kw == ".inputs") {
         next_tok.tokenID = token::INPUTS;
         cover = 'i';
         return;
     }
-    if (text.matches(".outputs")) {
+    if (kw == ".outputs") {
         next_tok.tokenID = token::OUTPUTS;
         cover = 'i';
         return;
     }
-    if (text.matches(".latch")) {
+    if (kw == ".latch") {
         next_tok.tokenID = token::LATCH;
         cover = 'i';
         return;
     }
-    if (text.matches(".names")) {
+    if (kw == ".names") {
         next_tok.tokenID = token::NAMES;
         num_id = 0;
         cover = 'i';
         return;
     }
-    if (text.matches(".wire_load_slope")) {
+    if (kw == ".subckt") {
+        next_tok.tokenID = token::SUBCKT;
+        cover = 'i';
+        return;
+    }
+    if (kw == ".search") {
+        next_tok.tokenID = token::SEARCH;
+        cover = 'i';
+        return;
+    }
+    if (kw == ".wire_load_slope") {
         next_tok.tokenID = token::WIRE;
         cover = 'i';
         return;
     }
-    if (text.matches(".end")) {
+    if (kw == ".end") {
         next_tok.tokenID = token::ENDMODEL;
         return;
     }
 
-    std::cerr << "Unsupported keyword '" << text.get() << "' on line " << next_tok.lineno << "\n";
+    std::cerr << "Unsupported keyword '" << kw << "' on line " << next_tok.lineno << "\n";
     exit(1);
 }
 
 void lexer::consume_ident()
 {
     // We already have the first character.
-    // Build up remaining chars
-    int c;
-    for (;;) {
-        c = fin.peek();
-        if (is_ident_char(c)) {
-            text.append(fin.get());
-            continue;
-        }
-        break;
-    }
-    text.finish();
+    // The token is just the span of ident chars in the buffer.
+    const char* start = pos-1;
+    skip_ident_chars();
     num_id ++;
     next_tok.tokenID = token::IDENT;
-    next_tok.attribute = std::string(text.get());
+    next_tok.attribute = strview(start, pos-start);
 }
 
 void lexer::consume_cover()
 {
     // We already have the first character.
-    // Build up remaing char(s)
-    int c;
-    for (;;) {
-        c = fin.peek();
-        if (c == '1' || c == '0' || c == '-') {
-            text.append(fin.get());
-            continue;
-        }
-        break;
-    }
-    text.finish();
+    // The token is just the span of cover chars in the buffer.
+    const char* start = pos-1;
+    while (pos < bufend && (*pos == '1' || *pos == '0' || *pos == '-')) ++pos;
     next_tok.tokenID = token::COVER;
-    next_tok.attribute = std::string(text.get());
+    next_tok.attribute = strview(start, pos-start);
 }
 
 void lexer::IllegalChar(char c)
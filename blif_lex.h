@@ -10,63 +10,20 @@
  */
 class lexer {
     private:
-        class lexeme {
-                char* buffer;
-                const unsigned bufmax;
-                unsigned p;
-                bool truncated;
-            public:
-                lexeme(unsigned bmax);
-                ~lexeme();
-
-                inline char start(char c) {
-                    truncated = false;
-                    p = 1;
-                    return buffer[0] = c;
-                }
-
-                inline char pop() {
-                    if (p) return buffer[--p];
-                    return 0;
-                }
-
-                inline void append(char c) {
-                    if (p < bufmax) {
-                        buffer[p++] = c;
-                    } else {
-                        truncated = true;
-                    }
-                }
-
-                inline void finish() {
-                    buffer[p] = 0;
-                }
-
-                inline bool is_truncated() const {
-                    return truncated;
-                }
-
-                inline const char* get() const {
-                    return buffer;
-                }
-
-                inline bool matches(const char* text) const {
-                    return (0==strcmp(buffer, text));
-                }
-            private:
-                lexeme(const lexeme&) = delete;
-                void operator=(const lexeme&) = delete;
-        };
-    private:
-        std::istream& fin;
+        // Entire input; either mmapped or read in large blocks
+        const char* buffer;
+        const char* bufend;
+        const char* pos;        // next unread character
+        size_t maplen;          // if nonzero, buffer is mmapped
         token next_tok;
-        lexeme text;
-        int num_inputs; // number of inputs consumed
         int num_id;     // number of identifiers consumed
         char cover;     // 'i': ident tokens; 'c': cover token; 'o': single out token
         std::string model_name;
     public:
-        lexer(std::istream& _fin);
+        // Read the whole stream, in large blocks
+        lexer(std::istream& fin);
+        // mmap fd if it is a regular file, otherwise read it in blocks
+        lexer(int fd);
 
         // Cleanup
         ~lexer();
@@ -91,14 +48,6 @@ class lexer {
             return next_tok.getId();
         }
 
-        inline void incNumInputs() {
-            num_inputs++;
-        }
-
-        inline const int getNumInputs() const {
-            return num_inputs;
-        }
-
         inline const int getNum() const {
             return num_id;
         }
@@ -115,11 +64,29 @@ class lexer {
             return model_name;
         }
 
+        // The whole input, e.g. for hashing
+        inline const char* getBuffer() const {
+            return buffer;
+        }
+
+        inline size_t getBufferLength() const {
+            return bufend - buffer;
+        }
+
     private:
         lexer(const lexer&) = delete;
         void operator=(const lexer&) = delete;
 
     private:
+        void init();
+
+        inline int next_char() {
+            return (pos < bufend) ? (unsigned char) *pos++ : EOF;
+        }
+        inline int peek_char() const {
+            return (pos < bufend) ? (unsigned char) *pos : EOF;
+        }
+
         void scan_token();
 
         void ignore_comment();
@@ -129,6 +96,11 @@ class lexer {
 
         void IllegalChar(char c);
 
+        // Advance pos past any ident chars
+        inline void skip_ident_chars() {
+            while (pos < bufend && is_ident_char(*pos)) ++pos;
+        }
+
         static inline bool is_ident_char(char c) {
             switch (c) {
                 case 'A':
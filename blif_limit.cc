@@ -0,0 +1,34 @@
+#include "blif_limit.h"
+
+#include <stdlib.h>
+
+growth_limit::growth_limit(uint64_t mn, double gr)
+{
+    min_nodes = mn;
+    growth = gr;
+    node_limit = min_nodes;
+}
+
+bool growth_limit::set(const char* arg)
+{
+    char* end;
+    unsigned long long mn = strtoull(arg, &end, 10);
+    double gr = growth;
+    if (end == arg) return false;
+    if (',' == *end) {
+        const char* g = end+1;
+        gr = strtod(g, &end);
+        if (end == g) return false;
+    }
+    if (*end || gr < 1.0) return false;
+    min_nodes = mn;
+    growth = gr;
+    node_limit = min_nodes;
+    return true;
+}
+
+void growth_limit::reset(uint64_t live)
+{
+    node_limit = live * growth;
+    if (node_limit < min_nodes) node_limit = min_nodes;
+}
@@ -0,0 +1,46 @@
+#ifndef BLIF_LIMIT_H
+#define BLIF_LIMIT_H
+
+#include <stdint.h>
+
+/*
+ * Node count threshold that follows the live size, for the
+ * garbage collection and reordering policies.
+ *
+ * Starts at min nodes.  After each collection (or reordering) it is
+ * reset to growth times what is left, but never below min.
+ */
+class growth_limit {
+        uint64_t min_nodes;
+        double growth;
+        uint64_t node_limit;
+    public:
+        growth_limit(uint64_t min_nodes, double growth);
+
+        /*
+         * Parse a threshold switch argument, "min[,growth]";
+         * growth is left alone if not given.
+         * Returns false if it makes no sense.
+         */
+        bool set(const char* arg);
+
+        /// Past the threshold?
+        inline bool exceeded(uint64_t nodes) const {
+            return nodes > node_limit;
+        }
+
+        /// Reset the threshold, with live nodes left
+        void reset(uint64_t live);
+
+        /// Growth times x, but at least x+1 (e.g., for node pages)
+        inline uint64_t grown(uint64_t x) const {
+            const uint64_t g = x * growth;
+            return (g > x) ? g : x+1;
+        }
+
+        inline uint64_t minimum() const { return min_nodes; }
+        inline double factor() const { return growth; }
+        inline uint64_t current() const { return node_limit; }
+};
+
+#endif
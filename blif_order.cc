@@ -0,0 +1,481 @@
+#include "blif_order.h"
+#include "blif_expr.h"
+#include "blif_sched.h"
+
+#include <list>
+#include <algorithm>
+
+/*
+ * What the orderings need to know about the DAG.
+ * Gates are numbered 0..n-1 (by topological_order),
+ * inputs n..n+m-1.
+ */
+struct order_dag {
+    std::vector<symbol*> topo;      // gates, fan-ins first
+    std::vector<symbol*> inputs;    // in file order
+    unsigned num_gates;
+    // Height: longest path from an input (inputs: 0)
+    std::vector<unsigned> height;
+
+    order_dag(symbol* sl, symbol* IN);
+
+    inline unsigned total() const { return num_gates + inputs.size(); }
+
+    /// Fan-ins of gate g, deepest first; ties in expression order
+    void fanins(const symbol* g, std::vector<symbol*> &out) const;
+};
+
+order_dag::order_dag(symbol* sl, symbol* IN)
+{
+    num_gates = topological_order(sl, topo);
+    for (symbol* p = IN; p; p=p->next) {
+        inputs.push_back(p);
+    }
+    std::sort(inputs.begin(), inputs.end(),
+        [](const symbol* a, const symbol* b) {
+            return a->level < b->level;
+        }
+    );
+    for (unsigned i=0; i<inputs.size(); i++) {
+        inputs[i]->id = num_gates + i;
+    }
+
+    height.assign(total(), 0);
+    std::vector<symbol*> fin;
+    for (unsigned i=0; i<topo.size(); i++) {
+        fin.clear();
+        topo[i]->build->fanins(fin);
+        unsigned h = 0;
+        for (unsigned k=0; k<fin.size(); k++) {
+            if (nullptr == fin[k]->build && INPUT != fin[k]->type) continue;
+            if (height[fin[k]->id] >= h) h = height[fin[k]->id] + 1;
+        }
+        height[topo[i]->id] = h;
+    }
+}
+
+void order_dag::fanins(const symbol* g, std::vector<symbol*> &out) const
+{
+    out.clear();
+    g->build->fanins(out);
+    // unassigned signals (e.g., latch outputs) lead nowhere
+    unsigned j = 0;
+    for (unsigned k=0; k<out.size(); k++) {
+        if (out[k]->build || INPUT == out[k]->type) out[j++] = out[k];
+    }
+    out.resize(j);
+    std::stable_sort(out.begin(), out.end(),
+        [this](const symbol* a, const symbol* b) {
+            return height[a->id] > height[b->id];
+        }
+    );
+}
+
+/*
+ * Depth-first from each output in turn, with an explicit stack.
+ * Calls start() before each output, and reach(input, fresh)
+ * for every input on the way, where fresh is true the first time
+ * any output reaches it.
+ * Gates are expanded once overall, or once per output if again
+ * is set, so every input below shared logic is reached again.
+ */
+template <class START, class REACH>
+static void traverse(symbol* sl, const order_dag &D, bool again,
+        START start, REACH reach)
+{
+    // Last output (from 1) to visit each node; always 1 unless again
+    std::vector<unsigned> stamp(D.total(), 0);
+    unsigned epoch = 0;
+    std::vector<symbol*> stack;
+    std::vector<symbol*> fin;
+
+    for (symbol* p = sl; p; p=p->next) {
+        if (OUTPUT != p->type || nullptr == p->build) continue;
+        start();
+        if (again || 0 == epoch) epoch++;
+        stack.push_back(p);
+        while (!stack.empty()) {
+            symbol* g = stack.back();
+            stack.pop_back();
+            const bool fresh = (0 == stamp[g->id]);
+            if (epoch == stamp[g->id]) {
+                if (INPUT == g->type) reach(g, false);
+                continue;
+            }
+            stamp[g->id] = epoch;
+            if (INPUT == g->type) {
+                reach(g, fresh);
+                continue;
+            }
+            D.fanins(g, fin);
+            // push in reverse, so the first fan-in is visited first
+            for (unsigned k=fin.size(); k; k--) {
+                stack.push_back(fin[k-1]);
+            }
+        }
+    }
+}
+
+/// Inputs not ranked yet go last, in file order
+static void rank_rest(const order_dag &D, std::vector<bool> &placed,
+        std::vector<symbol*> &ranked)
+{
+    for (unsigned i=0; i<D.inputs.size(); i++) {
+        if (!placed[i]) ranked.push_back(D.inputs[i]);
+    }
+}
+
+void order_dfs(symbol* sl, symbol* IN, std::vector<symbol*> &ranked)
+{
+    order_dag D(sl, IN);
+    std::vector<bool> placed(D.inputs.size(), false);
+    ranked.clear();
+    traverse(sl, D, false, [](){}, [&](symbol* in, bool fresh) {
+        if (!fresh) return;
+        placed[in->id - D.num_gates] = true;
+        ranked.push_back(in);
+    });
+    rank_rest(D, placed, ranked);
+}
+
+void order_interleave(symbol* sl, symbol* IN, std::vector<symbol*> &ranked)
+{
+    order_dag D(sl, IN);
+    std::vector<bool> placed(D.inputs.size(), false);
+    std::list<symbol*> order;
+    std::vector<std::list<symbol*>::iterator> where(D.inputs.size());
+
+    // New inputs go right after the last ranked input we passed;
+    // for each output, start at the front
+    std::list<symbol*>::iterator cursor;
+    auto start = [&]() {
+        cursor = order.begin();
+    };
+    auto reach = [&](symbol* in, bool fresh) {
+        const unsigned i = in->id - D.num_gates;
+        if (!fresh) {
+            cursor = where[i];
+            ++cursor;
+            return;
+        }
+        placed[i] = true;
+        where[i] = order.insert(cursor, in);
+    };
+    // every output passes all of its inputs, shared logic or not
+    traverse(sl, D, true, start, reach);
+
+    ranked.assign(order.begin(), order.end());
+    rank_rest(D, placed, ranked);
+}
+
+void order_level(symbol* sl, symbol* IN, std::vector<symbol*> &ranked)
+{
+    order_dag D(sl, IN);
+
+    // Depth: longest path to an output, outputs first
+    std::vector<unsigned> depth(D.total(), 0);
+    std::vector<bool> used(D.total(), false);
+    std::vector<symbol*> fin;
+    for (unsigned i=D.topo.size(); i; i--) {
+        symbol* g = D.topo[i-1];
+        if (OUTPUT == g->type) used[g->id] = true;
+        if (!used[g->id]) continue;
+        D.fanins(g, fin);
+        for (unsigned k=0; k<fin.size(); k++) {
+            const unsigned f = fin[k]->id;
+            used[f] = true;
+            if (depth[f] < depth[g->id]+1) depth[f] = depth[g->id]+1;
+        }
+    }
+
+    ranked.clear();
+    std::vector<bool> placed(D.inputs.size(), false);
+    for (unsigned i=0; i<D.inputs.size(); i++) {
+        if (!used[D.inputs[i]->id]) continue;
+        placed[i] = true;
+        ranked.push_back(D.inputs[i]);
+    }
+    // inputs are in file order, so stable sort breaks ties by file
+    std::stable_sort(ranked.begin(), ranked.end(),
+        [&depth](const symbol* a, const symbol* b) {
+            return depth[a->id] > depth[b->id];
+        }
+    );
+    rank_rest(D, placed, ranked);
+}
+
+/// The outputs, in list order
+static void list_outputs(symbol* sl, std::vector<symbol*> &outs)
+{
+    outs.clear();
+    for (symbol* p = sl; p; p=p->next) {
+        if (OUTPUT == p->type) outs.push_back(p);
+    }
+}
+
+/*
+ * Fan-in cone of each output, as gate and input ids; inputs
+ * are the ids from num_gates on.  Also the number of inputs.
+ */
+static void find_cones(const order_dag &D, const std::vector<symbol*> &outs,
+        std::vector< std::vector<unsigned> > &cone, std::vector<unsigned> &support)
+{
+    std::vector<unsigned> stamp(D.total(), 0);
+    std::vector<symbol*> stack;
+    std::vector<symbol*> fin;
+    cone.resize(outs.size());
+    support.assign(outs.size(), 0);
+
+    for (unsigned k=0; k<outs.size(); k++) {
+        if (nullptr == outs[k]->build) continue;
+        stamp[outs[k]->id] = k+1;
+        stack.push_back(outs[k]);
+        while (!stack.empty()) {
+            symbol* g = stack.back();
+            stack.pop_back();
+            cone[k].push_back(g->id);
+            if (INPUT == g->type) {
+                support[k]++;
+                continue;
+            }
+            D.fanins(g, fin);
+            for (unsigned i=0; i<fin.size(); i++) {
+                if (k+1 == stamp[fin[i]->id]) continue;
+                stamp[fin[i]->id] = k+1;
+                stack.push_back(fin[i]);
+            }
+        }
+    }
+}
+
+void outputs_by_depth(symbol* sl, symbol* IN, std::vector<symbol*> &outs)
+{
+    order_dag D(sl, IN);
+    list_outputs(sl, outs);
+    std::stable_sort(outs.begin(), outs.end(),
+        [&D](const symbol* a, const symbol* b) {
+            return D.height[a->id] < D.height[b->id];
+        }
+    );
+}
+
+void outputs_by_size(symbol* sl, symbol* IN, std::vector<symbol*> &outs)
+{
+    order_dag D(sl, IN);
+    list_outputs(sl, outs);
+    std::vector< std::vector<unsigned> > cone;
+    std::vector<unsigned> support;
+    find_cones(D, outs, cone, support);
+
+    std::vector<unsigned> pick(outs.size());
+    for (unsigned k=0; k<pick.size(); k++) pick[k] = k;
+    std::stable_sort(pick.begin(), pick.end(),
+        [&](unsigned a, unsigned b) {
+            if (support[a] != support[b]) return support[a] < support[b];
+            return cone[a].size() < cone[b].size();
+        }
+    );
+    std::vector<symbol*> listed(outs);
+    for (unsigned k=0; k<pick.size(); k++) {
+        outs[k] = listed[pick[k]];
+    }
+}
+
+void outputs_by_cluster(symbol* sl, symbol* IN, std::vector<symbol*> &outs)
+{
+    order_dag D(sl, IN);
+    std::vector<symbol*> listed;
+    list_outputs(sl, listed);
+    const unsigned n = listed.size();
+    std::vector< std::vector<unsigned> > cone;
+    std::vector<unsigned> support;
+    find_cones(D, listed, cone, support);
+
+    // Which outputs each gate or input is in
+    std::vector< std::vector<unsigned> > holders(D.total());
+    for (unsigned k=0; k<n; k++) {
+        for (unsigned i=0; i<cone[k].size(); i++) {
+            holders[cone[k][i]].push_back(k);
+        }
+    }
+
+    std::vector<bool> taken(n, false);
+    std::vector<unsigned> shared(n, 0);
+    std::vector<unsigned> touched;
+    outs.clear();
+    unsigned next = 0;
+    for (unsigned k=1; k<n; k++) {
+        if (cone[k].size() < cone[next].size()) next = k;
+    }
+    while (outs.size() < n) {
+        taken[next] = true;
+        outs.push_back(listed[next]);
+
+        for (unsigned t=0; t<touched.size(); t++) shared[touched[t]] = 0;
+        touched.clear();
+        for (unsigned i=0; i<cone[next].size(); i++) {
+            const std::vector<unsigned> &h = holders[cone[next][i]];
+            for (unsigned j=0; j<h.size(); j++) {
+                if (taken[h[j]]) continue;
+                if (0 == shared[h[j]]++) touched.push_back(h[j]);
+            }
+        }
+
+        // most shared; then smallest cone; then list order
+        unsigned best = n;
+        for (unsigned k=0; k<n; k++) {
+            if (taken[k]) continue;
+            if (n == best || shared[k] > shared[best] ||
+                (shared[k] == shared[best] && cone[k].size() < cone[best].size()))
+            {
+                best = k;
+            }
+        }
+        next = best;
+    }
+}
+
+void partition_outputs(symbol* sl, symbol* IN, unsigned max_outs,
+        unsigned num_parts, std::vector< std::vector<symbol*> > &parts)
+{
+    order_dag D(sl, IN);
+    std::vector<symbol*> listed;
+    list_outputs(sl, listed);
+    if (max_outs && listed.size() > max_outs) listed.resize(max_outs);
+    const unsigned n = listed.size();
+    std::vector< std::vector<unsigned> > cone;
+    std::vector<unsigned> support;
+    find_cones(D, listed, cone, support);
+
+    std::vector<unsigned> pick(n);
+    for (unsigned k=0; k<n; k++) pick[k] = k;
+    std::stable_sort(pick.begin(), pick.end(),
+        [&cone](unsigned a, unsigned b) {
+            return cone[a].size() > cone[b].size();
+        }
+    );
+
+    const unsigned np = std::min(num_parts, n);
+    // What each part needs so far, and how much
+    std::vector< std::vector<bool> > needs(np, std::vector<bool>(D.total(), false));
+    std::vector<unsigned> load(np, 0);
+    std::vector<unsigned> part_of(n);
+    for (unsigned i=0; i<n; i++) {
+        const std::vector<unsigned> &c = cone[pick[i]];
+        unsigned best = np;
+        unsigned best_new = 0;
+        for (unsigned p=0; p<np; p++) {
+            unsigned added = 0;
+            for (unsigned j=0; j<c.size(); j++) {
+                if (!needs[p][c[j]]) added++;
+            }
+            if (np == best || load[p] + added < load[best] + best_new ||
+                (load[p] + added == load[best] + best_new && load[p] < load[best]))
+            {
+                best = p;
+                best_new = added;
+            }
+        }
+        for (unsigned j=0; j<c.size(); j++) {
+            needs[best][c[j]] = true;
+        }
+        load[best] += best_new;
+        part_of[pick[i]] = best;
+    }
+
+    parts.assign(np, std::vector<symbol*>());
+    for (unsigned k=0; k<n; k++) {
+        parts[part_of[k]].push_back(listed[k]);
+    }
+}
+
+// Union-find root of x, halving paths on the way
+static unsigned find_root(std::vector<unsigned> &up, unsigned x)
+{
+    while (up[x] != x) {
+        up[x] = up[up[x]];
+        x = up[x];
+    }
+    return x;
+}
+
+void cluster_outputs(symbol* sl, symbol* IN, unsigned max_outs, double overlap,
+        std::vector<output_cluster> &clusters)
+{
+    order_dag D(sl, IN);
+    std::vector<symbol*> listed;
+    list_outputs(sl, listed);
+    if (max_outs && listed.size() > max_outs) listed.resize(max_outs);
+    const unsigned n = listed.size();
+    std::vector< std::vector<unsigned> > cone;
+    std::vector<unsigned> support;
+    find_cones(D, listed, cone, support);
+
+    // Which outputs each gate is in; inputs don't count as overlap
+    std::vector< std::vector<unsigned> > holders(D.num_gates);
+    for (unsigned k=0; k<n; k++) {
+        for (unsigned i=0; i<cone[k].size(); i++) {
+            if (cone[k][i] < D.num_gates) holders[cone[k][i]].push_back(k);
+        }
+    }
+
+    std::vector<unsigned> up(n);
+    for (unsigned k=0; k<n; k++) up[k] = k;
+    std::vector<unsigned> shared(n, 0);
+    std::vector<unsigned> touched;
+    for (unsigned k=0; k<n; k++) {
+        const unsigned gk = cone[k].size() - support[k];
+        for (unsigned i=0; i<cone[k].size(); i++) {
+            if (cone[k][i] >= D.num_gates) continue;
+            const std::vector<unsigned> &h = holders[cone[k][i]];
+            for (unsigned j=0; j<h.size(); j++) {
+                if (h[j] <= k) continue;
+                if (0 == shared[h[j]]++) touched.push_back(h[j]);
+            }
+        }
+        for (unsigned t=0; t<touched.size(); t++) {
+            const unsigned j = touched[t];
+            const unsigned gj = cone[j].size() - support[j];
+            if (shared[j] >= overlap * std::min(gk, gj)) {
+                up[find_root(up, j)] = find_root(up, k);
+            }
+            shared[j] = 0;
+        }
+        touched.clear();
+    }
+
+    // Gather, in list order of the first output
+    std::vector< std::vector<unsigned> > members;
+    std::vector<unsigned> which(n, n);
+    for (unsigned k=0; k<n; k++) {
+        const unsigned r = find_root(up, k);
+        if (n == which[r]) {
+            which[r] = members.size();
+            members.push_back(std::vector<unsigned>());
+        }
+        members[which[r]].push_back(k);
+    }
+
+    // and size each union cone
+    clusters.resize(members.size());
+    std::vector<unsigned> stamp(D.total(), 0);
+    for (unsigned c=0; c<members.size(); c++) {
+        output_cluster &C = clusters[c];
+        C.outputs.clear();
+        C.gates = C.support = 0;
+        for (unsigned m=0; m<members[c].size(); m++) {
+            const unsigned k = members[c][m];
+            C.outputs.push_back(listed[k]);
+            for (unsigned i=0; i<cone[k].size(); i++) {
+                const unsigned g = cone[k][i];
+                if (c+1 == stamp[g]) continue;
+                stamp[g] = c+1;
+                if (g < D.num_gates) {
+                    C.gates++;
+                } else {
+                    C.support++;
+                }
+            }
+        }
+    }
+}
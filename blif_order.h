@@ -0,0 +1,110 @@
+#ifndef BLIF_ORDER_H
+#define BLIF_ORDER_H
+
+#include <vector>
+
+struct symbol;
+
+/*
+ * Static variable orderings computed from the gate DAG.
+ *
+ * Each one ranks the inputs: the first input in the result
+ * belongs at one end of the order (the caller decides which),
+ * the last at the other.  Inputs no output depends on go last,
+ * in file order.  Input levels must still be their position
+ * in the file, which is used to break ties.
+ *
+ *      @param  sl      Outputs and gates
+ *      @param  IN      Inputs
+ *      @param  ranked  On return: all inputs, ranked
+ */
+
+/*
+ * Depth-first traversal of the fan-in cones, one output after
+ * another; inputs are ranked as they are first reached.
+ * At each gate, deeper fan-ins are visited first (Malik et al.).
+ */
+void order_dfs(symbol* sl, symbol* IN, std::vector<symbol*> &ranked);
+
+/*
+ * Like order_dfs, but inputs first reached from a later output are
+ * interleaved: each is placed right after the last already ranked
+ * input the traversal passed through (Fujita et al.).
+ */
+void order_interleave(symbol* sl, symbol* IN, std::vector<symbol*> &ranked);
+
+/*
+ * By logic level: inputs on the longest paths to an output first.
+ */
+void order_level(symbol* sl, symbol* IN, std::vector<symbol*> &ranked);
+
+/*
+ * Orders for building the outputs, since which gates are shared
+ * (and the compute table reused) depends on it.
+ * Each one lists every output in sl; ties keep list order.
+ *
+ *      @param  sl      Outputs and gates
+ *      @param  IN      Inputs
+ *      @param  outs    On return: the outputs, in build order
+ */
+
+/// Shallowest first, by longest path from an input
+void outputs_by_depth(symbol* sl, symbol* IN, std::vector<symbol*> &outs);
+
+/*
+ * Smallest estimated BDD first: fewest inputs in the support,
+ * then fewest gates in the fan-in cone.
+ */
+void outputs_by_size(symbol* sl, symbol* IN, std::vector<symbol*> &outs);
+
+/*
+ * Clustered: start with the smallest fan-in cone, then always
+ * take the output sharing the most gates and inputs with the
+ * one just taken, so outputs using the same gates are built
+ * back to back.
+ */
+void outputs_by_cluster(symbol* sl, symbol* IN, std::vector<symbol*> &outs);
+
+/*
+ * Split the outputs into parts to build independently, each in its
+ * own forest, so no work is shared between parts.  Outputs are
+ * taken largest fan-in cone first, each into the part that needs
+ * the fewest gates and inputs once it is added; gates the part
+ * needs already cost nothing.  Ties go to the part needing the
+ * least so far.  Within a part, outputs keep their list order.
+ *
+ *      @param  sl          Outputs and gates
+ *      @param  IN          Inputs
+ *      @param  max_outs    Only the first this many outputs; 0: all
+ *      @param  num_parts   How many parts; fewer if there are
+ *                          fewer outputs
+ *      @param  parts       On return: the parts, none empty
+ */
+void partition_outputs(symbol* sl, symbol* IN, unsigned max_outs,
+        unsigned num_parts, std::vector< std::vector<symbol*> > &parts);
+
+/*
+ * Cone-of-influence clusters: outputs whose fan-in cones overlap
+ * are grouped, so each cluster can be built (and its memory
+ * freed) independently of the others.  Two outputs are joined if
+ * they share at least overlap times the gates of the smaller cone;
+ * clusters are closed under that.  Clusters come in the list order
+ * of their first output; within one, outputs keep list order.
+ */
+struct output_cluster {
+    std::vector<symbol*> outputs;
+    unsigned gates;         // in the union of their fan-in cones
+    unsigned support;       // inputs in it
+};
+
+/*
+ *      @param  sl          Outputs and gates
+ *      @param  IN          Inputs
+ *      @param  max_outs    Only the first this many outputs; 0: all
+ *      @param  overlap     Fraction, 0 to 1
+ *      @param  clusters    On return: the clusters
+ */
+void cluster_outputs(symbol* sl, symbol* IN, unsigned max_outs, double overlap,
+        std::vector<output_cluster> &clusters);
+
+#endif
@@ -1,8 +1,105 @@
 #include "blif_par.h"
 #include "blif_expr.h"
+#include "blif_pipe.h"
+#include "blif_cache.h"
+#include "blif_sub.h"
+
+#include <vector>
+#include <set>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define MAX_SYMBOLS 1024
 
+// Largest sub-model BDD to compose; models past this are flattened
+#define MAX_SUB_NODES 65536
+
+/*
+ * A .subckt statement; bound once every model has been read
+ */
+struct subckt {
+    std::string model;
+    unsigned lineno;
+    std::vector<std::string> formals;
+    std::vector<symbol*> actuals;
+};
+
+/*
+ * Everything we know about one .model
+ */
+struct model {
+    std::string name;
+    // Hashed symbol table; the symbol list is
+    // in declaration order, most recent first
+    symbol_table ST;
+    // number of .inputs so far, for their levels
+    unsigned num_inputs;
+    std::vector<subckt> instances;
+    // how many times we have been instantiated, for naming
+    unsigned times_used;
+    // ' ': not flattened yet, 'f': flattening, 'd': done
+    char state;
+    // Function of the outputs, once instantiated; null if
+    // not tried yet, or too large (then it is flattened)
+    sub_bdd* fn;
+    bool tried_fn;
+
+    model(const std::string &n) : name(n) {
+        num_inputs = 0;
+        times_used = 0;
+        state = ' ';
+        fn = nullptr;
+        tried_fn = false;
+    }
+    ~model() {
+        delete fn;
+    }
+};
+
+/*
+ * All models read so far, including from .search files
+ */
+struct library {
+    std::vector<model*> models;
+    // The first model of the main file
+    model* top;
+    // Fan-ins of the current .names, reused across gates
+    std::vector<symbol*> fanin;
+    // Scratch for building gate expressions
+    expr_builder exprs;
+    // Streaming mode: where the top model's gates go
+    gate_queue* Q;
+    // Files read through .search, for the netlist cache
+    std::vector<source_file> searched;
+    // Canonical paths of the .search files being read, to catch
+    // cycles, and of those read already, to skip them
+    std::set<std::string> reading;
+    std::set<std::string> loaded;
+    // Directory of each .search file being read, innermost last;
+    // the paths it names are relative to it
+    std::vector<std::string> dirs;
+    // .subckt instances composed from sub_bdd, and copied
+    unsigned composed;
+    unsigned flattened;
+
+    library() {
+        top = nullptr;
+        Q = nullptr;
+        composed = flattened = 0;
+    }
+    ~library() {
+        for (unsigned i=0; i<models.size(); i++) delete models[i];
+    }
+
+    model* find(const std::string &name) const {
+        for (unsigned i=0; i<models.size(); i++) {
+            if (models[i]->name == name) return models[i];
+        }
+        return nullptr;
+    }
+};
+
 
 void expected(token::type want, const token& got)
 {
@@ -31,7 +128,7 @@ void match(lexer &L, token::type t)
     }
 }
 
-void process_inputs(lexer &L, symbol* &ST)
+void process_inputs(lexer &L, model &M, gate_queue* Q)
 {
     token t;
     for (;;) {
@@ -47,20 +144,21 @@ void process_inputs(lexer &L, symbol* &ST)
         }
 
         // Make sure it's not a duplicate symbol
-        symbol* find = move_to_front(ST, t.getAttr());
+        symbol* find = M.ST.find(t.getAttr());
         if (find) {
             std::cerr << "Error line " << t.getLine() << ":\n    ";
             find->duplicate_error();
         }
 
         // another input variable
-        L.incNumInputs();
-        ST = new symbol(t, ST);
-        ST->init_input(L.getNumInputs());
+        M.num_inputs++;
+        symbol* in = M.ST.insert(t);
+        in->init_input(M.num_inputs);
+        if (Q) Q->push(in);
     }
 }
 
-void process_outputs(lexer &L, symbol* &ST)
+void process_outputs(lexer &L, symbol_table &ST, expr_builder &B, gate_queue* Q)
 {
     token t;
     for (;;) {
@@ -76,20 +174,19 @@ void process_outputs(lexer &L, symbol* &ST)
         }
 
         // Make sure it's not a duplicate symbol
-        symbol* find = move_to_front(ST, t.getAttr());
+        symbol* find = ST.find(t.getAttr());
         if (find) {
             if (find->type == INPUT) {
                 // which means this input is output
-                expr* E;
-                product* P = new product;
-                sum* S = new sum;
-                E = new term(find);
-                P->push(E);
-                S->push(P);
-                ST = new symbol(t, find);
-                ST->init_output();
-                ST->name += "_OUT";
-                ST->build = S;
+                B.begin();
+                B.begin();
+                B.push(B.leaf(find));
+                B.push(B.end(expr::PRODUCT));
+                B.end(expr::SUM);
+                symbol* out = ST.insert(t, "_OUT");
+                out->init_output();
+                out->build = B.finish();
+                if (Q) Q->push(out);
                 continue;
             }
             std::cerr << "Error line " << t.getLine() << ":\n    ";
@@ -98,61 +195,56 @@ void process_outputs(lexer &L, symbol* &ST)
         }
 
         // another output variable
-        ST = new symbol(t, ST);
-        ST->init_output();
+        ST.insert(t)->init_output();
     }
 }
 
-void process_latches(lexer &L, symbol* &ST)
+void process_latches(lexer &L, symbol_table &ST)
 {
     //
     std::cerr << "latches not implemented\n";
 }
 
-expr* parse_product(lexer &L, symbol* &ST, const unsigned num) {
+unsigned parse_product(lexer &L, const std::vector<symbol*> &fanin, expr_builder &B) {
     // this is used for parsing a single line of covers
+    const unsigned num = fanin.size();
     token t;
     L.consume(t);
-    expr* E;
-    product* P = new product;
+    unsigned E;
+    B.begin();
     for (unsigned i=0; i<num-1; i++) {
         if (t.getAttr()[i] == '1') {
-            E = new term(ST->get_nsymbol(num-1-i));
-            P->push(E);
-            E = 0;
+            E = B.leaf(fanin[i]);
+            B.push(E);
         } else if (t.getAttr()[i] == '0') {
-            E = new term(ST->get_nsymbol(num-1-i));
-            E->complement();
-            P->push(E);
-            E = 0;
+            E = B.leaf(fanin[i]);
+            B.complement(E);
+            B.push(E);
         } else {
             continue;
         }
     }
-    return P;
+    return B.end(expr::PRODUCT);
 }
 
-expr* process_covers(lexer &L, symbol* &ST, const unsigned num){
-    // for A B ... C D, we know the idents in ST (linked list) is 
-    //  in order of D C ... B A
-    
+expr* process_covers(lexer &L, const std::vector<symbol*> &fanin, expr_builder &B){
+    // for A B ... C D, fanin holds A B ... C D;
+    //  the cover columns index the first num-1 of them
+    const unsigned num = fanin.size();
+
     // if the number is 1, next token should be 0/1 or .names/.end
     if (num == 1) {
         if (L.peek().matches(token::SO)) {
             // 0 or 1?
-            term* E = 0;
-            E = new term(ST);
-            E->constant();
+            unsigned E = B.leaf(fanin[0], expr::CONST);
             if (L.peek().getAttr() == "1") {
-                E->complement();
+                B.complement(E);
             }
-            return E;
+            return B.finish();
         } else if (L.peek().matches(token::NAMES) || L.peek().matches(token::ENDMODEL)) {
             // .names/.end
-            term* E = 0;
-            E = new term(ST);
-            E->constant();
-            return E;
+            B.leaf(fanin[0], expr::CONST);
+            return B.finish();
         } else {
             std::cerr << "got number of ident: " << L.getNum() << "\n";
             expect2(token::SO, token::NAMES, L.peek());
@@ -161,8 +253,9 @@ expr* process_covers(lexer &L, symbol* &ST, const unsigned num){
 
     // bool has_cover = 0;
     token t;
-    expr* E = 0;
-    sum* S = new sum;
+    unsigned E;
+    bool knows_so = false;
+    B.begin();
     // now ready to parse the cover and set the expression
     for (;;) {
         t = L.peek();
@@ -180,12 +273,15 @@ expr* process_covers(lexer &L, symbol* &ST, const unsigned num){
             }
             expected(token::COVER, t);
         }
-        if (t.getAttr()[num-2] == 0 || t.getAttr()[num-1] != 0) {
-            std::cerr << "number of digits should equal to the number of input gates\n";
+        // Covers are never truncated, so the width must match exactly
+        if (t.getAttr().length() != num-1) {
+            std::cerr << "Error line " << t.getLine() << ":\n    ";
+            std::cerr << "number of digits should equal to the number of input gates";
+            std::cerr << " (got " << t.getAttr().length() << ", expected " << num-1 << ")\n";
             exit(1);
         }
 
-        E = parse_product(L, ST, num);
+        E = parse_product(L, fanin, B);
         L.consume(t);
         if (! t.matches(token::SO)) {
             if (t.matches(token::NEWLINE)) {
@@ -195,50 +291,55 @@ expr* process_covers(lexer &L, symbol* &ST, const unsigned num){
                 expected(token::SO, t);
             }
         }
-        if (t.getAttr()[0] == 0 || t.getAttr()[1] != 0) {
+        if (t.getAttr().length() != 1) {
             std::cerr << "number of digits should equal to 1 for single output\n";
             exit(1);
         }
-        if (!S->knows_complemented()) {
+        if (!knows_so) {
             // 
             if (t.getAttr()[0] == '0') {
-                E->complement();
-                S->got_so();
+                B.complement(E);
+                knows_so = true;
             } else if (t.getAttr()[0] == '1') {
-                S->got_so();
+                knows_so = true;
             } else {
                 std::cerr << "unknown single output flag\n";
                 exit(1);
             }
         } else {
-            if ((t.getAttr()[0] == '0') ^ (S->is_complemented())) {
+            // the sum itself is never complemented
+            if (t.getAttr()[0] == '0') {
                 std::cerr << "single output flag error\n";
                 exit(1);
             }
         }
-        if (t.getAttr()[0] == '0') E->complement();
-        S->push(E);
-        E = 0;
+        if (t.getAttr()[0] == '0') B.complement(E);
+        B.push(E);
         L.consume(t);
         if (! t.matches(token::NEWLINE)) {
             expected(token::NEWLINE, t);
         }
     }
-    return S;
+    E = B.end(expr::SUM);
+    if (knows_so) B.got_so(E);
+    return B.finish();
 }
 
-void process_names(lexer &L, symbol* &ST) {
-    // parse the idents in order and move them to front
-    unsigned num_names = 0;
+void process_names(lexer &L, symbol_table &ST, std::vector<symbol*> &fanin,
+        expr_builder &B, gate_queue* Q) {
+    // collect the idents in order; the last one is the lhs
+    fanin.clear();
     token t;
     for (;;) {
         L.consume(t);
 
         if (t.matches(token::NEWLINE)) {
             if (L.getCover() == 'b') continue;
-            symbol* lhs = ST;
-            lhs->set_rhs(t.getLine(), process_covers(L, ST, num_names));
-            // process_covers(L, ST, num_names);
+            if (fanin.empty()) expected(token::IDENT, t);
+            symbol* lhs = fanin.back();
+            expr* rhs = process_covers(L, fanin, B);
+            if (Q)  Q->define(lhs, t.getLine(), rhs);
+            else    lhs->set_rhs(t.getLine(), rhs);
             break;
         }
 
@@ -246,34 +347,215 @@ void process_names(lexer &L, symbol* &ST) {
             expected(token::IDENT, t);
         }
 
-        // Here must be ident, move to front if found
-        symbol* find = move_to_front(ST, t.getAttr());
-        if (find) {
-            ST = find;
-            num_names ++;
-            continue;
+        // Here must be ident
+        symbol* find = ST.find(t.getAttr());
+        if (nullptr == find) {
+            // another temp gate
+            find = ST.insert(t);
+            find->init_temp();
+        }
+        fanin.push_back(find);
+    }
+}
+
+void process_subckt(lexer &L, model &M)
+{
+    token t;
+    L.consume(t);
+    if (! t.matches(token::IDENT)) {
+        expected(token::IDENT, t);
+    }
+    M.instances.push_back(subckt());
+    subckt &S = M.instances.back();
+    S.model = t.getAttr().str();
+    S.lineno = t.getLine();
+
+    for (;;) {
+        L.consume(t);
+
+        if (t.matches(token::NEWLINE)) {
+            if (L.getCover() == 'b') continue;
+            break;
         }
 
-        // another temp gate
-        ST = new symbol(t, ST);
-        ST->init_temp();
-        num_names ++;
+        // formal=actual
+        if (! t.matches(token::IDENT)) {
+            expected(token::IDENT, t);
+        }
+        S.formals.push_back(t.getAttr().str());
+        match(L, token::EQUALS);
+        L.consume(t);
+        if (! t.matches(token::IDENT)) {
+            expected(token::IDENT, t);
+        }
+        S.actuals.push_back(M.ST.make_entry(false, t));
     }
 }
 
 /*
- * Main parsing process
+ * Bind one .subckt of M to the (already flattened) model sub.
+ * Formals are bound to the actual signals of M.  Each bound output
+ * gets an expression that composes the function of sub, built once
+ * for all instances, with the actual inputs.
+ * If sub is too large for that, it is copied instead: every other
+ * signal of sub gets a fresh temporary named model#k/signal.
  */
-symbol* parse(lexer &L)
+void instantiate(model &M, const subckt &S, model &sub, library &lib, gate_queue* Q)
 {
-    // Really simple symbol table (linked list), should be fine
-    // unless we get models with more than hundreds of variables
-    symbol* ST = 0;
+    if (!sub.tried_fn) {
+        sub.tried_fn = true;
+        sub.fn = new sub_bdd(MAX_SUB_NODES);
+        if (!sub.fn->build(sub.ST.list(), sub.num_inputs)) {
+            delete sub.fn;
+            sub.fn = nullptr;
+        }
+    }
 
-    // TBD: output roots
-    // TBD: symbol table for inputs
-    // TBD: symbol table for outputs
+    unsigned n = 0;
+    for (symbol* p = sub.ST.list(); p; p=p->next) {
+        p->id = n++;
+    }
+    std::vector<symbol*> map(n, nullptr);
+
+    for (unsigned i=0; i<S.formals.size(); i++) {
+        const std::string &formal = S.formals[i];
+        symbol* f = sub.ST.find(strview(formal.data(), formal.length()));
+        if (nullptr == f || (INPUT != f->type && OUTPUT != f->type)) {
+            std::cerr << "Error line " << S.lineno << ":\n    ";
+            std::cerr << formal << " is not an input or output of model " << sub.name << "\n";
+            throw 2;
+        }
+        if (OUTPUT == f->type && INPUT == S.actuals[i]->type) {
+            std::cerr << "Error line " << S.lineno << ":\n    ";
+            std::cerr << "Input " << S.actuals[i]->name << " driven by " << sub.name << "\n";
+            throw 2;
+        }
+        map[f->id] = S.actuals[i];
+    }
 
+    if (sub.fn) {
+        std::vector<symbol*> in(sub.num_inputs+1, nullptr);
+        for (symbol* p = sub.ST.list(); p; p=p->next) {
+            if (INPUT != p->type) continue;
+            if (nullptr == map[p->id]) {
+                std::cerr << "Error line " << S.lineno << ":\n    ";
+                std::cerr << "Input " << p->name << " of model " << sub.name << " not connected\n";
+                throw 2;
+            }
+            in[p->level] = map[p->id];
+        }
+        for (symbol* p = sub.ST.list(); p; p=p->next) {
+            // unbound or never assigned outputs drive nothing
+            if (OUTPUT != p->type || nullptr == map[p->id] || !sub.fn->has(p)) continue;
+            expr* e = sub.fn->instance(p, in, lib.exprs);
+            if (Q)  Q->define(map[p->id], S.lineno, e);
+            else    map[p->id]->set_rhs(S.lineno, e);
+        }
+        lib.composed++;
+        return;
+    }
+    lib.flattened++;
+
+    const std::string prefix = sub.name + "#" + std::to_string(sub.times_used++) + "/";
+    for (symbol* p = sub.ST.list(); p; p=p->next) {
+        if (map[p->id]) continue;
+        if (INPUT == p->type) {
+            std::cerr << "Error line " << S.lineno << ":\n    ";
+            std::cerr << "Input " << p->name << " of model " << sub.name << " not connected\n";
+            throw 2;
+        }
+        map[p->id] = M.ST.insert(prefix + p->name, S.lineno);
+        map[p->id]->init_temp();
+    }
+
+    for (symbol* p = sub.ST.list(); p; p=p->next) {
+        if (nullptr == p->build) continue;
+        if (Q)  Q->define(map[p->id], S.lineno, p->build->clone(map));
+        else    map[p->id]->set_rhs(S.lineno, p->build->clone(map));
+    }
+}
+
+/*
+ * Replace every .subckt of M by its model's function, or a copy.
+ * Each model is flattened only once, no matter how often it is used.
+ */
+void flatten(library &lib, model &M)
+{
+    if ('d' == M.state) return;
+    if ('f' == M.state) {
+        std::cerr << "Error: model " << M.name << " instantiates itself\n";
+        throw 2;
+    }
+    M.state = 'f';
+    for (unsigned i=0; i<M.instances.size(); i++) {
+        const subckt &S = M.instances[i];
+        model* sub = lib.find(S.model);
+        if (nullptr == sub) {
+            std::cerr << "Error line " << S.lineno << ":\n    ";
+            std::cerr << "Unknown model " << S.model << "\n";
+            throw 2;
+        }
+        flatten(lib, *sub);
+        instantiate(M, S, *sub, lib, (&M == lib.top) ? lib.Q : nullptr);
+    }
+    M.state = 'd';
+}
+
+void parse_file(lexer &L, library &lib, bool main_file);
+
+void process_search(lexer &L, library &lib)
+{
+    token t;
+    L.consume(t);
+    if (! t.matches(token::IDENT)) {
+        expected(token::IDENT, t);
+    }
+    const std::string name = t.getAttr().str();
+    // The main file is relative to the working directory
+    std::string file = name;
+    if ('/' != name[0] && !lib.dirs.empty()) file = lib.dirs.back() + name;
+
+    char* real = realpath(file.c_str(), nullptr);
+    int fd = real ? open(real, O_RDONLY) : -1;
+    if (fd < 0) {
+        free(real);
+        std::cerr << "Error line " << t.getLine() << ":\n    ";
+        std::cerr << "Couldn't open " << name << " for .search\n";
+        throw 2;
+    }
+    const std::string path(real);
+    free(real);
+    if (lib.reading.count(path)) {
+        close(fd);
+        std::cerr << "Error line " << t.getLine() << ":\n    ";
+        std::cerr << ".search cycle through " << name << "\n";
+        throw 2;
+    }
+    if (lib.loaded.count(path)) {
+        close(fd);
+        return;
+    }
+    lexer SL(fd);
+    close(fd);
+    source_file f;
+    f.path = path;
+    f.hash = content_hash(SL.getBuffer(), SL.getBufferLength());
+    lib.searched.push_back(f);
+
+    lib.reading.insert(path);
+    lib.dirs.push_back(path.substr(0, path.rfind('/')+1));
+    parse_file(SL, lib, false);
+    lib.dirs.pop_back();
+    lib.reading.erase(path);
+    lib.loaded.insert(path);
+}
+
+/*
+ * Read every model in one file into lib
+ */
+void parse_file(lexer &L, library &lib, bool main_file)
+{
+    model* M = nullptr;
     token t;
 
     //
@@ -289,40 +571,59 @@ symbol* parse(lexer &L)
         if (t.matches(token::MODEL)) {
             L.consume(t);
             if (! t.matches(token::IDENT))  expected(token::IDENT, t);
-            L.setModelName(t.getAttr());
+            if (lib.find(t.getAttr().str())) {
+                std::cerr << "Error line " << t.getLine() << ":\n    ";
+                std::cerr << "Model " << t.getAttr() << " defined already\n";
+                throw 2;
+            }
+            M = new model(t.getAttr().str());
+            lib.models.push_back(M);
+            if (main_file && nullptr == lib.top) {
+                lib.top = M;
+                L.setModelName(M->name);
+            }
             std::cerr << "Processing model " << t.getAttr() << "\n";
             continue;
         }
-        // End of this model
-        if (t.matches(token::ENDMODEL) || t.matches(token::END)) break;
+        // End of this model, or of the file
+        if (t.matches(token::ENDMODEL)) {
+            M = nullptr;
+            continue;
+        }
+        if (t.matches(token::END)) break;
+
+        // Process include files
+        if (t.matches(token::SEARCH)) {
+            process_search(L, lib);
+            continue;
+        }
+
+        if (t.matches(token::NEWLINE)) continue;
+
+        // Statements outside of .model ... .end
+        if (nullptr == M) {
+            M = new model("");
+            lib.models.push_back(M);
+            if (main_file && nullptr == lib.top) lib.top = M;
+        }
+        // Only the circuit itself is streamed
+        gate_queue* Q = (M == lib.top) ? lib.Q : nullptr;
 
         // Process inputs variables
         if (t.matches(token::INPUTS)) {
-            // if (saw_inputs) {
-            //     std::cerr << "Error on line " << t.getLine() << ":\n    ";
-            //     std::cerr << "Another .inputs statement?\n";
-            //     throw 2;
-            // }
-            process_inputs(L, ST);
-            // saw_inputs = true;
+            process_inputs(L, *M, Q);
             continue;
         }
 
         // Process outputs variables
         if (t.matches(token::OUTPUTS)) {
-            // if (saw_outputs) {
-            //     std::cerr << "Error on line " << t.getLine() << ":\n    ";
-            //     std::cerr << "Another .outputs statement?\n";
-            //     throw 2;
-            // }
-            process_outputs(L, ST);
-            // saw_outputs = true;
+            process_outputs(L, M->ST, lib.exprs, Q);
             continue;
         }
 
         // Process Latches
         if (t.matches(token::LATCH)) {
-            process_latches(L, ST);
+            process_latches(L, M->ST);
             continue;
         }
 
@@ -333,10 +634,38 @@ symbol* parse(lexer &L)
 
         // Process expressions 
         if (t.matches(token::NAMES)) {
-            process_names(L, ST);
+            process_names(L, M->ST, lib.fanin, lib.exprs, Q);
+            continue;
+        }
+
+        // Process sub-circuits
+        if (t.matches(token::SUBCKT)) {
+            process_subckt(L, *M);
             continue;
         }
     }
+}
 
-    return ST;
+/*
+ * Main parsing process
+ */
+symbol* parse(lexer &L, gate_queue* Q, std::vector<source_file>* searched)
+{
+    // Models, from the main file and any .search files
+    library lib;
+    lib.Q = Q;
+    parse_file(L, lib, true);
+    if (searched) {
+        searched->insert(searched->end(), lib.searched.begin(), lib.searched.end());
+    }
+    if (nullptr == lib.top) return nullptr;
+
+    // The first model is the circuit; the rest are
+    // only used through .subckt
+    flatten(lib, *lib.top);
+    if (lib.composed || lib.flattened) {
+        std::cerr << "Sub-circuit instances: " << lib.composed << " composed, "
+                  << lib.flattened << " flattened\n";
+    }
+    return lib.top->ST.list();
 }
@@ -1,6 +1,18 @@
 
 #include "blif_lex.h"
 
+#include <vector>
+
 struct symbol;
+struct source_file;
+class gate_queue;
 
-symbol* parse(lexer &L);
+/*
+ * Parse the circuit; returns its symbol list.
+ * If Q is given, the inputs and gates of the circuit are
+ * also pushed there as soon as they are complete.
+ * If searched is given, the files read through .search
+ * are appended to it, with the hash of what was read.
+ */
+symbol* parse(lexer &L, gate_queue* Q = nullptr,
+        std::vector<source_file>* searched = nullptr);
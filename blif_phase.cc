@@ -0,0 +1,172 @@
+#include "blif_phase.h"
+
+#ifdef PHASE_TIMING
+
+#include <vector>
+#include <mutex>
+#include <iomanip>
+#include <string.h>
+
+struct phase_node {
+    const char* name;
+    phase_node* parent;
+    std::vector<phase_node*> kids;
+    uint64_t calls;
+    uint64_t nanos;
+
+    phase_node(const char* n, phase_node* p) : name(n), parent(p) {
+        calls = nanos = 0;
+    }
+
+    phase_node* kid(const char* n) {
+        for (unsigned i=0; i<kids.size(); i++) {
+            if (kids[i]->name == n || 0==strcmp(kids[i]->name, n)) return kids[i];
+        }
+        kids.push_back(new phase_node(n, this));
+        return kids.back();
+    }
+};
+
+// Histogram buckets: gate build times in [2^b, 2^(b+1)) ns
+static const unsigned NUM_BUCKETS = 48;
+
+/*
+ * Per thread.  Never freed: the report reads them
+ * after the threads are gone.
+ */
+struct phase_thread {
+    phase_node root;
+    phase_node* current;
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t gate_nanos;
+
+    phase_thread() : root("", nullptr) {
+        current = &root;
+        for (unsigned b=0; b<NUM_BUCKETS; b++) buckets[b] = 0;
+        gate_nanos = 0;
+    }
+};
+
+static std::mutex all_lock;
+static std::vector<phase_thread*> all_threads;
+static thread_local phase_thread* mine = nullptr;
+
+static phase_thread* this_thread()
+{
+    if (nullptr == mine) {
+        mine = new phase_thread;
+        std::lock_guard<std::mutex> guard(all_lock);
+        all_threads.push_back(mine);
+    }
+    return mine;
+}
+
+static inline uint64_t nanos_since(std::chrono::steady_clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t).count();
+}
+
+phase_scope::phase_scope(const char* name)
+{
+    phase_thread* T = this_thread();
+    node = T->current->kid(name);
+    T->current = node;
+    start = std::chrono::steady_clock::now();
+}
+
+phase_scope::~phase_scope()
+{
+    node->nanos += nanos_since(start);
+    node->calls++;
+    mine->current = node->parent;
+}
+
+gate_clock::~gate_clock()
+{
+    const uint64_t ns = nanos_since(start);
+    phase_thread* T = this_thread();
+    unsigned b = 0;
+    while (b+1 < NUM_BUCKETS && (ns >> (b+1))) b++;
+    T->buckets[b]++;
+    T->gate_nanos += ns;
+}
+
+// Add the tree under from into the tree under into, by name
+static void merge(phase_node* into, const phase_node* from)
+{
+    for (unsigned i=0; i<from->kids.size(); i++) {
+        phase_node* k = into->kid(from->kids[i]->name);
+        k->calls += from->kids[i]->calls;
+        k->nanos += from->kids[i]->nanos;
+        merge(k, from->kids[i]);
+    }
+}
+
+static void show(std::ostream &s, const phase_node* n, unsigned depth, uint64_t whole)
+{
+    std::string label(2*depth, ' ');
+    label += n->name;
+    s << std::left << std::setw(32) << label << std::right
+      << std::setw(10) << n->calls
+      << std::setw(14) << std::fixed << std::setprecision(6) << n->nanos / 1e9
+      << std::setw(9) << std::setprecision(1)
+      << (whole ? 100.0 * n->nanos / whole : 0.0) << "%\n";
+    for (unsigned i=0; i<n->kids.size(); i++) {
+        show(s, n->kids[i], depth+1, n->nanos);
+    }
+}
+
+// Lower bound of bucket b, with units
+static std::string bucket_label(unsigned b)
+{
+    static const char* unit[] = { "ns", "us", "ms", "s" };
+    double v = double(uint64_t(1) << b);
+    unsigned u = 0;
+    while (v >= 1000 && u < 3) {
+        v /= 1000;
+        u++;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3g %s", v, unit[u]);
+    return buf;
+}
+
+void phase_report(std::ostream &s)
+{
+    std::lock_guard<std::mutex> guard(all_lock);
+    phase_node all("", nullptr);
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t gates = 0, gate_nanos = 0;
+    for (unsigned b=0; b<NUM_BUCKETS; b++) buckets[b] = 0;
+    for (unsigned t=0; t<all_threads.size(); t++) {
+        merge(&all, &all_threads[t]->root);
+        for (unsigned b=0; b<NUM_BUCKETS; b++) {
+            buckets[b] += all_threads[t]->buckets[b];
+            gates += all_threads[t]->buckets[b];
+        }
+        gate_nanos += all_threads[t]->gate_nanos;
+    }
+    uint64_t whole = 0;
+    for (unsigned i=0; i<all.kids.size(); i++) whole += all.kids[i]->nanos;
+
+    const std::ios::fmtflags was = s.flags();
+    const std::streamsize prec = s.precision();
+    s << "========================Phases==========================\n";
+    s << std::left << std::setw(32) << "Phase" << std::right << std::setw(10) << "Calls"
+      << std::setw(14) << "Seconds" << std::setw(10) << "Share" << "\n";
+    for (unsigned i=0; i<all.kids.size(); i++) {
+        show(s, all.kids[i], 0, whole);
+    }
+    s << "Gate builds: \t\t" << gates << ", " << std::setprecision(6)
+      << gate_nanos / 1e9 << " seconds\n";
+    for (unsigned b=0; b<NUM_BUCKETS; b++) {
+        if (0 == buckets[b]) continue;
+        s << "    from " << std::left << std::setw(10) << bucket_label(b) << std::right
+          << std::setw(12) << buckets[b] << "\n";
+    }
+    s.flags(was);
+    s.precision(prec);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef BLIF_PHASE_H
+#define BLIF_PHASE_H
+
+/*
+ * Phase timing; compiled in only with PHASE_TIMING defined
+ * (in defines.h, or -DPHASE_TIMING),
+ * otherwise the macros below expand to nothing.
+ *
+ *      PHASE("name");      Time the rest of the enclosing scope
+ *      GATE_TIMED();       Same, for one gate build; these go
+ *                          into a histogram instead
+ *      PHASE_REPORT(s);    Write the breakdown to ostream s
+ *
+ * A phase started while another is running is reported under it,
+ * so the same name may show up in several places.  Each thread
+ * keeps its own tree and histogram, without locking; the report
+ * merges them by path, so call it once the threads are done.
+ * Times come from a monotonic clock.
+ */
+
+#include "defines.h"
+
+#ifdef PHASE_TIMING
+
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+
+struct phase_node;
+
+class phase_scope {
+        phase_node* node;
+        std::chrono::steady_clock::time_point start;
+    public:
+        phase_scope(const char* name);
+        ~phase_scope();
+};
+
+class gate_clock {
+        std::chrono::steady_clock::time_point start;
+    public:
+        inline gate_clock() : start(std::chrono::steady_clock::now()) { }
+        ~gate_clock();
+};
+
+void phase_report(std::ostream &s);
+
+#define PHASE_JOIN2(a, b)   a ## b
+#define PHASE_JOIN(a, b)    PHASE_JOIN2(a, b)
+#define PHASE(name)         phase_scope PHASE_JOIN(phase_at_, __LINE__)(name)
+#define GATE_TIMED()        gate_clock PHASE_JOIN(gate_at_, __LINE__)
+#define PHASE_REPORT(s)     phase_report(s)
+
+#else
+
+#define PHASE(name)
+#define GATE_TIMED()
+#define PHASE_REPORT(s)
+
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+#include "blif_pipe.h"
+#include "blif_expr.h"
+#include "blif_build.h"
+
+/*
+ * gate_queue methods
+ */
+
+gate_queue::gate_queue()
+{
+    closed = false;
+}
+
+void gate_queue::push(symbol* s)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    items.push_back(s);
+    nonempty.notify_one();
+}
+
+void gate_queue::define(symbol* lhs, unsigned lineno, expr* rhs)
+{
+    // set_rhs() adds lhs to the parents of its fan-ins,
+    // which the builder may be reading; see parents_of()
+    std::lock_guard<std::mutex> guard(lock);
+    lhs->set_rhs(lineno, rhs);
+    items.push_back(lhs);
+    nonempty.notify_one();
+}
+
+void gate_queue::close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    nonempty.notify_one();
+}
+
+bool gate_queue::pop_all(std::vector<symbol*> &out)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (items.empty() && !closed) {
+        nonempty.wait(guard);
+    }
+    if (items.empty()) return false;
+    out.insert(out.end(), items.begin(), items.end());
+    items.clear();
+    return true;
+}
+
+void gate_queue::parents_of(const symbol* s, std::vector<symbol*> &out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    out.clear();
+    for (const symlist* p = s->parents; p; p=p->next) {
+        out.push_back(p->item);
+    }
+}
+
+/*
+ * gate_builder methods
+ */
+
+gate_builder::gate_builder(build_state* _S, char type, bool top)
+{
+    S = _S;
+    bdd_type = type;
+    top_first = top;
+    have_forest = false;
+    gates_built = 0;
+    error = false;
+    first_seconds = 0;
+    got_first = false;
+    worker = std::thread(&gate_builder::run, this);
+}
+
+bool gate_builder::finish()
+{
+    Q.close();
+    worker.join();
+    return !error;
+}
+
+void gate_builder::run()
+{
+    std::vector<symbol*> batch;
+    while (Q.pop_all(batch)) {
+        for (unsigned i=0; i<batch.size(); i++) {
+            symbol* s = batch[i];
+            if (INPUT == s->type) {
+                if (have_forest) {
+                    std::cerr << "Input " << s->name << " on line " << s->lineno
+                              << " follows the first .names; can't stream this file\n";
+                    error = true;
+                    continue;
+                }
+                inputs.push_back(s);
+                continue;
+            }
+            if (!have_forest) init_forest();
+            if (s->build->ready(*S)) {
+                build(s);
+            } else {
+                waiting.insert(s);
+            }
+        }
+        batch.clear();
+    }
+    // No gates at all?
+    if (!have_forest) init_forest();
+}
+
+void gate_builder::init_forest()
+{
+    // All inputs are known now, so we can fix their levels
+    const unsigned num_vars = inputs.size();
+    if (top_first) {
+        for (unsigned i=0; i<num_vars; i++) {
+            inputs[i]->level = num_vars+1 - inputs[i]->level;
+        }
+    }
+    S->init_forest(bdd_type, num_vars);
+    for (unsigned i=0; i<num_vars; i++) {
+        S->build_input(inputs[i]);
+    }
+    have_forest = true;
+}
+
+void gate_builder::build(symbol* g)
+{
+    std::vector<symbol*> work(1, g);
+    std::vector<symbol*> parents;
+    while (!work.empty()) {
+        symbol* s = work.back();
+        work.pop_back();
+
+        s->build->rearrange();
+        S->build(s);
+        ++gates_built;
+        if (OUTPUT == s->type && !got_first) {
+            clock.note_time();
+            first_seconds = clock.get_last_seconds();
+            got_first = true;
+        }
+
+        // Anyone waiting only on s?
+        Q.parents_of(s, parents);
+        for (unsigned i=0; i<parents.size(); i++) {
+            symbol* p = parents[i];
+            if (0==waiting.count(p)) continue;
+            if (! p->build->ready(*S)) continue;
+            waiting.erase(p);
+            work.push_back(p);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef BLIF_PIPE_H
+#define BLIF_PIPE_H
+
+#include "timer.h"
+
+#include <deque>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+struct symbol;
+class expr;
+class build_state;
+
+/*
+ * Streaming mode: the parser hands over each input and each
+ * completed gate as soon as it is read, and a builder thread
+ * constructs every gate whose fan-ins are already built.
+ */
+class gate_queue {
+        std::mutex lock;
+        std::condition_variable nonempty;
+        std::deque<symbol*> items;
+        bool closed;
+    public:
+        gate_queue();
+
+        /// Parser side: an input, or a gate whose expression is set
+        void push(symbol* s);
+
+        /// Parser side: set_rhs() and push(), as one step
+        void define(symbol* lhs, unsigned lineno, expr* rhs);
+
+        /// Parser side: nothing more is coming
+        void close();
+
+        /*
+         * Builder side: wait for more symbols and move them into out.
+         * Returns false once the queue is closed and drained.
+         */
+        bool pop_all(std::vector<symbol*> &out);
+
+        /// Builder side: copy the parents of s (the parser may add more)
+        void parents_of(const symbol* s, std::vector<symbol*> &out);
+};
+
+class gate_builder {
+        build_state* S;
+        char bdd_type;
+        bool top_first;         // first .input at the top (-oF)
+        gate_queue Q;
+        std::thread worker;
+
+        std::vector<symbol*> inputs;
+        // Gates we have, whose fan-ins are not all built yet
+        std::unordered_set<symbol*> waiting;
+        bool have_forest;
+        unsigned gates_built;
+        bool error;
+
+        timer clock;            // started with us
+        double first_seconds;   // when the first output was done
+        bool got_first;
+    public:
+        gate_builder(build_state* S, char bdd_type, bool top_first);
+
+        inline gate_queue* queue() { return &Q; }
+
+        /// Close the queue and wait for the builder; false on error
+        bool finish();
+
+        inline unsigned numBuilt() const { return gates_built; }
+        inline bool builtOutput() const { return got_first; }
+        inline double firstOutputSeconds() const { return first_seconds; }
+
+    private:
+        void run();
+        void init_forest();
+        void build(symbol* g);
+};
+
+#endif
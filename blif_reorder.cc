@@ -0,0 +1,82 @@
+#include "blif_reorder.h"
+#include "blif_stats.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+reorder_policy::reorder_policy(uint64_t mn, double gr) : nodes(mn, gr)
+{
+    num_runs = 0;
+    num_changes = 0;
+    num_trials = 0;
+    num_abandoned = 0;
+    nodes_before = 0;
+    nodes_after = 0;
+    seconds = 0;
+}
+
+// Address space in use, in bytes; the largest resident size
+// where there is no /proc
+static uint64_t address_space_used()
+{
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        unsigned long pages;
+        const bool ok = (1 == fscanf(f, "%lu", &pages));
+        fclose(f);
+        if (ok) return uint64_t(pages) * sysconf(_SC_PAGESIZE);
+    }
+    return max_rss_kb() * 1024;
+}
+
+uint64_t reorder_policy::room(const rexdd_forest_t &F, uint64_t node_limit) const
+{
+    uint64_t nodes = node_limit ? node_limit : UINT64_MAX;
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_AS, &lim) || RLIM_INFINITY == lim.rlim_cur) return nodes;
+    const uint64_t used = address_space_used();
+    if (used >= lim.rlim_cur) return 0;
+    // all of it charged to the live nodes, so this errs on the small side
+    const uint64_t per_node = used / (F.UT->num_entries + 1) + 1;
+    const uint64_t fit = (lim.rlim_cur - used) / per_node;
+    return (fit < nodes) ? fit : nodes;
+}
+
+void reorder_policy::tried(bool abandoned)
+{
+    num_trials++;
+    if (abandoned) num_abandoned++;
+}
+
+void reorder_policy::reordered(uint64_t before, uint64_t after, bool changed, double secs)
+{
+    num_runs++;
+    if (changed) num_changes++;
+    nodes_before += before;
+    nodes_after += after;
+    seconds += secs;
+
+    nodes.reset(after);
+}
+
+void reorder_policy::report(std::ostream &s) const
+{
+    s << "Reorder thresholds: \t" << nodes.minimum() << " nodes, growth " << nodes.factor() << "\n";
+    s << "Reorder runs: \t\t" << num_runs << " (" << num_changes << " changed the order)\n";
+    s << "Reorder trials: \t" << num_trials << " (" << num_abandoned << " given up)\n";
+    s << "Reorder live nodes: \t" << nodes_before << " before, " << nodes_after << " after\n";
+    s << "Reorder time: \t\t" << seconds << " seconds\n";
+}
+
+void reorder_policy::report(FILE* fout) const
+{
+    fprintf(fout, "RO_min\t%llu\n", (unsigned long long) nodes.minimum());
+    fprintf(fout, "RO_growth\t%f\n", nodes.factor());
+    fprintf(fout, "RO_runs\t%u\n", num_runs);
+    fprintf(fout, "RO_changes\t%u\n", num_changes);
+    fprintf(fout, "RO_trials\t%u\n", num_trials);
+    fprintf(fout, "RO_abandoned\t%u\n", num_abandoned);
+    fprintf(fout, "RO_before\t%llu\n", (unsigned long long) nodes_before);
+    fprintf(fout, "RO_after\t%llu\n", (unsigned long long) nodes_after);
+    fprintf(fout, "RO_time\t%f\n", seconds);
+}
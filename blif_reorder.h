@@ -0,0 +1,74 @@
+#ifndef BLIF_REORDER_H
+#define BLIF_REORDER_H
+
+#include "rexdd.h"
+#include "blif_limit.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * When to reorder the variables during construction (-r).
+ *
+ * RexDD cannot swap levels in place, so reordering is done by
+ * rebuilding the gates built so far under each of the static
+ * orderings, and carrying on with whichever leaves the fewest
+ * live nodes (which may be the current one).
+ *
+ * Checked right after each garbage collection, when the unique
+ * table holds only live nodes.  Reordering is due when they are
+ * past a growth_limit, which then follows what is left.
+ */
+class reorder_policy {
+        growth_limit nodes;
+
+        // What happened, for the statistics
+        unsigned num_runs;
+        unsigned num_changes;       // runs that switched orderings
+        unsigned num_trials;        // rebuilds under another ordering
+        unsigned num_abandoned;     // trials given up as too large
+        uint64_t nodes_before;      // live nodes, summed over runs
+        uint64_t nodes_after;
+        double seconds;
+    public:
+        reorder_policy(uint64_t min_nodes = 1 << 20, double growth = 2.0);
+
+        /// Thresholds from a switch argument; see growth_limit::set()
+        inline bool set(const char* arg) { return nodes.set(arg); }
+
+        /// Time to reorder?  Only meaningful right after a collection
+        inline bool due(const rexdd_forest_t &F) const {
+            return nodes.exceeded(F.UT->num_entries);
+        }
+
+        /*
+         * How many nodes a trial may reach beside F: the address
+         * space left (ulimit -v), at what F's live nodes cost now,
+         * and no more than node_limit (-M), unless that is 0.
+         */
+        uint64_t room(const rexdd_forest_t &F, uint64_t node_limit) const;
+
+        /// A trial rebuild finished, or was given up
+        void tried(bool abandoned);
+
+        /*
+         * A reordering just finished.
+         *
+         *      @param  before  Live nodes before
+         *      @param  after   Live nodes in the rebuilt forest
+         *      @param  changed True if the ordering changed
+         *      @param  secs    Time taken, trials included
+         */
+        void reordered(uint64_t before, uint64_t after, bool changed, double secs);
+
+        inline unsigned numRuns() const { return num_runs; }
+
+        /// Human readable summary of the thresholds and decisions
+        void report(std::ostream &s) const;
+
+        /// Same, as tab separated lines for the history file
+        void report(FILE* fout) const;
+};
+
+#endif
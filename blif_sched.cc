@@ -0,0 +1,181 @@
+#include "blif_sched.h"
+#include "blif_expr.h"
+#include "blif_build.h"
+#include "blif_phase.h"
+
+// Visit states, indexed by symbol::id
+static const unsigned char UNSEEN = 0;
+static const unsigned char ACTIVE = 1;      // on the DFS stack
+static const unsigned char DONE   = 2;
+
+static void visit(symbol* s, std::vector<unsigned char> &state,
+        std::vector<symbol*> &out, const build_state* S, bool strict);
+
+unsigned topological_order(symbol* sl, std::vector<symbol*> &out,
+        const build_state* S)
+{
+    unsigned n = 0;
+    for (symbol* p = sl; p; p=p->next) {
+        p->id = n++;
+    }
+    std::vector<unsigned char> state(n, UNSEEN);
+    for (symbol* p = sl; p; p=p->next) {
+        if (p->build) visit(p, state, out, S, false);
+    }
+    return n;
+}
+
+build_schedule::build_schedule(symbol* sl, unsigned max_outs, build_state &_S)
+    : S(&_S)
+{
+    std::vector<symbol*> want;
+    for (symbol* p = sl; p; p=p->next) {
+        if (OUTPUT != p->type) continue;
+        want.push_back(p);
+        if (max_outs && want.size() == max_outs) break;
+    }
+    init(sl, want);
+}
+
+build_schedule::build_schedule(symbol* sl, const std::vector<symbol*> &want,
+        build_state &_S) : S(&_S)
+{
+    init(sl, want);
+}
+
+void build_schedule::init(symbol* sl, const std::vector<symbol*> &want)
+{
+    //
+    // Rearrange expressions for variable order.
+    // Any topological order will do here.
+    //
+    std::vector<symbol*> topo;
+    const unsigned n = topological_order(sl, topo, S);
+    {
+        PHASE("rearrange");
+        for (unsigned i=0; i<topo.size(); i++) {
+            topo[i]->build->rearrange();
+        }
+    }
+
+    //
+    // Now the build order, which follows the rearranged fan-ins
+    //
+    std::vector<unsigned char> state(n, UNSEEN);
+    for (unsigned k=0; k<want.size(); k++) {
+        visit(want[k], state, order, S, true);
+        outs.push_back(want[k]);
+        ends.push_back(order.size());
+    }
+
+    num_released = 0;
+    count_uses(n);
+    // Gates built while streaming, that nothing here needs
+    for (symbol* p = sl; p; p=p->next) {
+        if (S->computed(p) && 0==refs[p->id]) release(p);
+    }
+}
+
+void build_schedule::built(unsigned i)
+{
+    for (unsigned u=use_first[i]; u<use_first[i+1]; u++) {
+        symbol* g = uses[u];
+        ASSERT(refs[g->id]);
+        if (0 == --refs[g->id]) release(g);
+    }
+}
+
+/*
+ * Fan-out counts, for gates in the schedule and
+ * gates already computed.
+ */
+void build_schedule::count_uses(unsigned n)
+{
+    refs.assign(n, 0);
+    std::vector<unsigned> seen(n, 0);   // stamp: last consumer + 1
+    std::vector<symbol*> fanin;
+
+    use_first.push_back(0);
+    for (unsigned i=0; i<order.size(); i++) {
+        fanin.clear();
+        order[i]->build->fanins(fanin);
+        for (unsigned k=0; k<fanin.size(); k++) {
+            symbol* g = fanin[k];
+            if (INPUT == g->type || nullptr == g->build) continue;
+            if (i+1 == seen[g->id]) continue;
+            seen[g->id] = i+1;
+            refs[g->id]++;
+            uses.push_back(g);
+        }
+        use_first.push_back(uses.size());
+    }
+}
+
+void build_schedule::release(symbol* g)
+{
+    if (OUTPUT == g->type || !S->release(g)) return;
+    num_released++;
+}
+
+static void check_assigned(const symbol* s)
+{
+    if (s->build) return;
+    std::cerr << "Error line " << s->lineno << ":\n    ";
+    std::cerr << s->name << " is never assigned\n";
+    throw 2;
+}
+
+/*
+ * Depth-first postorder from s, with an explicit stack.
+ * Fan-ins are visited in the order construct() uses them,
+ * so gates are built in the same order as a recursive build would.
+ * If not strict, unassigned fan-ins (e.g., latch outputs) are skipped.
+ */
+static void visit(symbol* s, std::vector<unsigned char> &state,
+        std::vector<symbol*> &out, const build_state* S, bool strict)
+{
+    if ((S && S->computed(s)) || DONE == state[s->id]) return;
+
+    struct frame {
+        symbol* gate;
+        unsigned first;         // fan-ins of gate start at fanin[first]
+        unsigned next;
+    };
+    std::vector<frame> stack;
+    std::vector<symbol*> fanin;
+
+    frame f;
+    f.gate = s;
+    f.first = f.next = 0;
+    check_assigned(s);
+    s->build->fanins(fanin);
+    stack.push_back(f);
+    state[s->id] = ACTIVE;
+
+    while (!stack.empty()) {
+        frame &top = stack.back();
+        if (top.next < fanin.size()) {
+            symbol* g = fanin[top.next++];
+            if (INPUT == g->type || (S && S->computed(g))) continue;
+            if (DONE == state[g->id]) continue;
+            if (ACTIVE == state[g->id]) {
+                std::cerr << "Error line " << g->lineno << ":\n    ";
+                std::cerr << "Combinational loop through " << g->name << "\n";
+                throw 2;
+            }
+            if (!strict && nullptr == g->build) continue;
+            check_assigned(g);
+            f.gate = g;
+            f.first = f.next = fanin.size();
+            g->build->fanins(fanin);
+            state[g->id] = ACTIVE;
+            stack.push_back(f);     // top is invalid now
+            continue;
+        }
+        // all fan-ins scheduled
+        fanin.resize(top.first);
+        state[top.gate->id] = DONE;
+        out.push_back(top.gate);
+        stack.pop_back();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef BLIF_SCHED_H
+#define BLIF_SCHED_H
+
+#include <vector>
+
+struct symbol;
+class build_state;
+
+/*
+ * Order in which to build the gates: a topological order
+ * of the gate DAG (every gate after its fan-ins), computed once
+ * without recursion, grouped by the output that first needs them.
+ *
+ * Also rearranges every gate's expression for the variable order,
+ * fan-ins first, so top levels are never chased recursively.
+ *
+ * Gates already computed (e.g., by the streaming builder)
+ * are left out.
+ */
+class build_schedule {
+        build_state* S;
+        std::vector<symbol*> order;     // gates, fan-ins first
+        std::vector<symbol*> outs;      // outputs, in list order
+        std::vector<unsigned> ends;     // output k needs order[ends[k-1] .. ends[k])
+
+        // Distinct fan-in gates of order[i]: uses[use_first[i] .. use_first[i+1])
+        std::vector<symbol*> uses;
+        std::vector<unsigned> use_first;
+        // Consumers of each gate not built yet, by symbol::id
+        std::vector<unsigned> refs;
+        unsigned num_released;
+    public:
+        /*
+         * Schedule the outputs in symbol list sl, for building in S.
+         *
+         *      @param  sl          Outputs and gates
+         *      @param  max_outs    Stop after this many outputs; 0: all
+         *      @param  S           Forest to build in
+         */
+        build_schedule(symbol* sl, unsigned max_outs, build_state &S);
+
+        /// As above, for just the outputs in outs, in that order
+        build_schedule(symbol* sl, const std::vector<symbol*> &outs,
+                build_state &S);
+
+        /// Build in S from now on; it took over the forest (reordering)
+        inline void attach(build_state &_S) { S = &_S; }
+
+        inline unsigned numOutputs() const { return outs.size(); }
+        inline symbol* output(unsigned k) const { return outs[k]; }
+
+        /// Gates to build for output k: gate(begin(k)) .. gate(end(k)-1)
+        inline unsigned begin(unsigned k) const { return k ? ends[k-1] : 0; }
+        inline unsigned end(unsigned k) const { return ends[k]; }
+
+        inline unsigned numGates() const { return order.size(); }
+        inline symbol* gate(unsigned i) const { return order[i]; }
+
+        /*
+         * Gate(i) was just built.  Fan-in gates with no consumers
+         * left give up their root edge in S, unless they are outputs.
+         */
+        void built(unsigned i);
+
+        /// How many gate roots were given up so far
+        inline unsigned numReleased() const { return num_released; }
+
+    private:
+        void init(symbol* sl, const std::vector<symbol*> &outs);
+        void count_uses(unsigned n);
+        void release(symbol* g);
+};
+
+/*
+ * Topological order (fan-ins first) of the gates and outputs
+ * in symbol list sl that are not computed in S yet (all of them,
+ * if S is null), without recursion.
+ * Numbers sl from 0 in symbol::id; returns how many there are.
+ */
+unsigned topological_order(symbol* sl, std::vector<symbol*> &out,
+        const build_state* S = nullptr);
+
+#endif
@@ -0,0 +1,150 @@
+#include "blif_stats.h"
+#include "defines.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+// Every column, in CSV order
+static const char* columns[] = {
+    "record", "model", "type", "ordering", "out_order", "partition",
+    "status", "inputs", "outputs", "built",
+    "output", "index", "level", "nodes", "ut_nodes", "inc_nodes",
+    "peak_nodes", "final_nodes",
+    "and_calls", "and_terms", "and_ct_hits", "not_calls", "not_ct_hits",
+    "ct_mallocs", "ct_overwrites", "released",
+    "gc_runs", "gc_freed", "gc_seconds",
+    "parse_seconds", "prep_seconds", "build_seconds", "count_seconds",
+    "seconds", "max_rss_kb"
+};
+static const unsigned num_columns = sizeof(columns) / sizeof(columns[0]);
+
+static unsigned column(const char* key)
+{
+    for (unsigned i=0; i<num_columns; i++) {
+        if (0==strcmp(key, columns[i])) return i;
+    }
+    ASSERT(false);  // not in the list
+    return 0;
+}
+
+/*
+ * stats_record methods
+ */
+
+stats_record::stats_record(const char* kind)
+    : values(num_columns), quoted(num_columns, false)
+{
+    set("record", kind);
+}
+
+void stats_record::put(const char* key, const std::string &v, bool q)
+{
+    const unsigned c = column(key);
+    values[c] = v;
+    quoted[c] = q;
+}
+
+void stats_record::set(const char* key, const std::string &v)
+{
+    put(key, v, true);
+}
+
+void stats_record::set(const char* key, const char* v)
+{
+    put(key, v, true);
+}
+
+void stats_record::set(const char* key, uint64_t v)
+{
+    put(key, std::to_string((unsigned long long) v), false);
+}
+
+void stats_record::set(const char* key, int64_t v)
+{
+    put(key, std::to_string((long long) v), false);
+}
+
+void stats_record::set(const char* key, double v)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6f", v);
+    put(key, buf, false);
+}
+
+/*
+ * stats_writer methods
+ */
+
+stats_writer::stats_writer()
+{
+    out = nullptr;
+    csv = false;
+}
+
+stats_writer::~stats_writer()
+{
+    if (out) fclose(out);
+}
+
+bool stats_writer::open(const char* path, bool as_csv)
+{
+    out = fopen(path, "a");
+    if (nullptr == out) return false;
+    csv = as_csv;
+    if (csv && 0 == ftell(out)) {
+        for (unsigned i=0; i<num_columns; i++) {
+            fprintf(out, "%s%s", i ? "," : "", columns[i]);
+        }
+        fprintf(out, "\n");
+    }
+    return true;
+}
+
+// Quote s for JSON (escape = '\\') or CSV (escape = '"')
+static void put_string(FILE* out, const std::string &s, char escape)
+{
+    fputc('"', out);
+    for (unsigned i=0; i<s.length(); i++) {
+        const char c = s[i];
+        if ('"' == c || (escape == '\\' && '\\' == c)) fputc(escape, out);
+        fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+void stats_writer::write(const stats_record &r)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    bool first = true;
+    if (!csv) fputc('{', out);
+    for (unsigned i=0; i<num_columns; i++) {
+        if (csv) {
+            if (i) fputc(',', out);
+            if (r.values[i].empty()) continue;
+        } else {
+            if (r.values[i].empty()) continue;
+            if (!first) fputc(',', out);
+            fprintf(out, "\"%s\":", columns[i]);
+            first = false;
+        }
+        if (r.quoted[i]) {
+            put_string(out, r.values[i], csv ? '"' : '\\');
+        } else {
+            fputs(r.values[i].c_str(), out);
+        }
+    }
+    if (!csv) fputc('}', out);
+    fputc('\n', out);
+    fflush(out);
+}
+
+uint64_t max_rss_kb()
+{
+    struct rusage u;
+    if (getrusage(RUSAGE_SELF, &u)) return 0;
+#ifdef __APPLE__
+    return u.ru_maxrss / 1024;      // bytes there
+#else
+    return u.ru_maxrss;
+#endif
+}
@@ -0,0 +1,59 @@
+#ifndef BLIF_STATS_H
+#define BLIF_STATS_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * One line of machine readable statistics (-X): either a whole
+ * forest ("run") or one output in it ("output").
+ * Fields are set by name, from the fixed list of columns in
+ * blif_stats.cc; anything not set is left out (JSON) or empty (CSV).
+ */
+class stats_record {
+        std::vector<std::string> values;    // by column; empty: not set
+        std::vector<bool> quoted;           // strings, not numbers
+    public:
+        stats_record(const char* kind);
+
+        void set(const char* key, const std::string &v);
+        void set(const char* key, const char* v);
+        void set(const char* key, uint64_t v);
+        void set(const char* key, int64_t v);
+        void set(const char* key, double v);
+
+    private:
+        void put(const char* key, const std::string &v, bool q);
+        friend class stats_writer;
+};
+
+/*
+ * Appends records to a file, as JSON lines or CSV.
+ * A CSV file gets the header line when it is started.
+ * Safe to use from several build threads.
+ */
+class stats_writer {
+        FILE* out;
+        bool csv;
+        std::mutex lock;
+    public:
+        stats_writer();
+        ~stats_writer();
+
+        /// Open path for appending; false on error
+        bool open(const char* path, bool csv);
+
+        void write(const stats_record &r);
+
+    private:
+        stats_writer(const stats_writer&) = delete;
+        void operator=(const stats_writer&) = delete;
+};
+
+/// Largest resident set so far, in KB; whole process
+uint64_t max_rss_kb();
+
+#endif
@@ -0,0 +1,194 @@
+#include "blif_sub.h"
+#include "blif_expr.h"
+#include "blif_sched.h"
+
+#include <algorithm>
+
+const unsigned sub_bdd::NONE;
+
+sub_bdd::sub_bdd(unsigned max) : max_nodes(max)
+{
+    node t;
+    t.var = 0;
+    t.lo = t.hi = 0;
+    nodes.push_back(t);
+    t.lo = t.hi = 1;
+    nodes.push_back(t);
+    full = false;
+}
+
+bool sub_bdd::build(symbol* sl, unsigned num_inputs)
+{
+    std::vector<symbol*> topo;
+    const unsigned n = topological_order(sl, topo);
+    value.assign(n, NONE);
+    unique.resize(num_inputs+1);
+    for (symbol* p = sl; p; p=p->next) {
+        if (INPUT != p->type) continue;
+        ASSERT(p->level && p->level <= num_inputs);
+        value[p->id] = make(p->level, 0, 1);
+    }
+    for (unsigned i=0; i<topo.size(); i++) {
+        const unsigned f = eval(topo[i]->build);
+        if (NONE == f || full) return false;
+        value[topo[i]->id] = f;
+    }
+    return true;
+}
+
+bool sub_bdd::has(const symbol* s) const
+{
+    return NONE != value[s->id];
+}
+
+unsigned sub_bdd::make(unsigned v, unsigned lo, unsigned hi)
+{
+    if (lo == hi) return lo;
+    const uint64_t key = (uint64_t(lo) << 32) | hi;
+    std::unordered_map<uint64_t, unsigned>::const_iterator it = unique[v].find(key);
+    if (it != unique[v].end()) return it->second;
+    if (nodes.size() >= max_nodes) {
+        full = true;
+        return 0;
+    }
+    node x;
+    x.var = v;
+    x.lo = lo;
+    x.hi = hi;
+    nodes.push_back(x);
+    unique[v][key] = nodes.size()-1;
+    return nodes.size()-1;
+}
+
+unsigned sub_bdd::apply(bool sum, unsigned f, unsigned g)
+{
+    if (f > g) std::swap(f, g);
+    if (f == g) return f;
+    if (f <= 1) {
+        // f is a terminal, g is not the same one
+        if (sum)    return f ? 1 : g;
+        else        return f ? g : 0;
+    }
+    std::unordered_map<uint64_t, unsigned> &cache = sum ? ors : ands;
+    const uint64_t key = (uint64_t(f) << 32) | g;
+    std::unordered_map<uint64_t, unsigned>::const_iterator it = cache.find(key);
+    if (it != cache.end()) return it->second;
+
+    const node a = nodes[f];
+    const node b = nodes[g];
+    const unsigned v = std::max(a.var, b.var);
+    const unsigned lo = apply(sum, (a.var == v) ? a.lo : f, (b.var == v) ? b.lo : g);
+    const unsigned hi = apply(sum, (a.var == v) ? a.hi : f, (b.var == v) ? b.hi : g);
+    const unsigned r = make(v, lo, hi);
+    cache[key] = r;
+    return r;
+}
+
+unsigned sub_bdd::negate(unsigned f)
+{
+    if (f <= 1) return 1-f;
+    if (f >= nots.size()) nots.resize(nodes.size(), NONE);
+    if (NONE != nots[f]) return nots[f];
+    const node a = nodes[f];
+    const unsigned lo = negate(a.lo);
+    const unsigned hi = negate(a.hi);
+    const unsigned r = make(a.var, lo, hi);
+    nots[f] = r;
+    return r;
+}
+
+unsigned sub_bdd::ite(unsigned s, unsigned h, unsigned l)
+{
+    const unsigned t = apply(false, s, h);
+    const unsigned e = apply(false, negate(s), l);
+    return apply(true, t, e);
+}
+
+/*
+ * Function of an expression of the model, node by node
+ * (operands come first); NONE if it uses an unassigned signal
+ */
+unsigned sub_bdd::eval(const expr* e)
+{
+    std::vector<unsigned> val(e->numNodes());
+    for (unsigned i=0; i<e->numNodes() && !full; i++) {
+        unsigned f;
+        switch (e->op(i)) {
+            case expr::TERM:
+                f = value[e->var(i)->id];
+                if (NONE == f) return NONE;
+                break;
+
+            case expr::CONST:
+                // as expr::construct() does
+                f = e->is_complemented(i) ? 1 : 0;
+                break;
+
+            case expr::CHOOSE:
+                f = ite(val[e->arg(i, 0)], val[e->arg(i, 1)], val[e->arg(i, 2)]);
+                break;
+
+            default:
+                f = (expr::PRODUCT == e->op(i)) ? 1 : 0;
+                for (unsigned k=0; k<e->numArgs(i); k++) {
+                    f = apply(expr::SUM == e->op(i), f, val[e->arg(i, k)]);
+                }
+        }
+        val[i] = e->is_complemented(i) ? negate(f) : f;
+    }
+    return full ? NONE : val[e->root()];
+}
+
+expr* sub_bdd::instance(const symbol* s, const std::vector<symbol*> &in,
+        expr_builder &B) const
+{
+    const unsigned f = value[s->id];
+    ASSERT(NONE != f);
+    if (f > 1 && nodes[f].lo <= 1 && nodes[f].hi <= 1) {
+        // a single literal
+        const unsigned E = B.leaf(in[nodes[f].var]);
+        if (0 == nodes[f].hi) B.complement(E);
+        return B.finish();
+    }
+    std::unordered_map<unsigned, unsigned> done, leaves;
+    emit(f, in, B, done, leaves);
+    return B.finish();
+}
+
+/*
+ * Add node f and everything below it to B, once each;
+ * constants are empty sums and products
+ */
+unsigned sub_bdd::emit(unsigned f, const std::vector<symbol*> &in, expr_builder &B,
+        std::unordered_map<unsigned, unsigned> &done,
+        std::unordered_map<unsigned, unsigned> &leaves) const
+{
+    std::unordered_map<unsigned, unsigned>::const_iterator it = done.find(f);
+    if (it != done.end()) return it->second;
+
+    unsigned E;
+    if (f <= 1) {
+        B.begin();
+        E = B.end(f ? expr::PRODUCT : expr::SUM);
+    } else {
+        const node &x = nodes[f];
+        const unsigned lo = emit(x.lo, in, B, done, leaves);
+        const unsigned hi = emit(x.hi, in, B, done, leaves);
+        unsigned sel;
+        it = leaves.find(x.var);
+        if (it == leaves.end()) {
+            sel = B.leaf(in[x.var]);
+            leaves[x.var] = sel;
+        } else {
+            sel = it->second;
+        }
+        // lists come out newest first: select, high, low
+        B.begin();
+        B.push(lo);
+        B.push(hi);
+        B.push(sel);
+        E = B.end(expr::CHOOSE);
+    }
+    done[f] = E;
+    return E;
+}
@@ -0,0 +1,76 @@
+#ifndef BLIF_SUB_H
+#define BLIF_SUB_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+struct symbol;
+class expr;
+class expr_builder;
+
+/*
+ * The outputs of one .model, as a small reduced ordered BDD over
+ * its .inputs.  It is built once, however often the model is used;
+ * each .subckt then gets, per output, an expression that composes
+ * it with the actual signals: one expr::CHOOSE node per BDD node,
+ * so no per-instance copies of the model's gates are built.
+ *
+ * It is private to the parser, so it works the same for every
+ * forest type.  Node 0 is false, node 1 is true; variable v is
+ * the input at level v of the model.
+ */
+class sub_bdd {
+        struct node {
+            unsigned var;       // 0 for the terminals
+            unsigned lo, hi;
+        };
+        std::vector<node> nodes;
+        // Unique table per variable: (lo, hi) -> node
+        std::vector< std::unordered_map<uint64_t, unsigned> > unique;
+        // Operation caches: (f, g) -> node, with f <= g
+        std::unordered_map<uint64_t, unsigned> ands, ors;
+        std::vector<unsigned> nots;
+        const unsigned max_nodes;
+        bool full;
+
+        // Per symbol of the model, by symbol::id: its node, or NONE
+        std::vector<unsigned> value;
+        static const unsigned NONE = ~0u;
+    public:
+        sub_bdd(unsigned max_nodes);
+
+        /*
+         * Build every gate of a model with num_inputs inputs,
+         * whose symbol list is sl; numbers sl in symbol::id.
+         * False if the BDD would exceed max_nodes, or a gate
+         * depends on a signal that is never assigned; the model
+         * must be flattened instead.
+         */
+        bool build(symbol* sl, unsigned num_inputs);
+
+        /// Did build() give signal s of the model a function?
+        bool has(const symbol* s) const;
+
+        /*
+         * Expression for signal s of the model in one instance,
+         * where in[v] is the actual signal for input level v.
+         * Goes into the active arena, like every expression.
+         */
+        expr* instance(const symbol* s, const std::vector<symbol*> &in,
+                expr_builder &B) const;
+
+        inline unsigned numNodes() const { return nodes.size(); }
+
+    private:
+        unsigned make(unsigned v, unsigned lo, unsigned hi);
+        unsigned apply(bool sum, unsigned f, unsigned g);
+        unsigned negate(unsigned f);
+        unsigned ite(unsigned s, unsigned h, unsigned l);
+        unsigned eval(const expr* e);
+        unsigned emit(unsigned f, const std::vector<symbol*> &in, expr_builder &B,
+                std::unordered_map<unsigned, unsigned> &done,
+                std::unordered_map<unsigned, unsigned> &leaves) const;
+};
+
+#endif
@@ -31,8 +31,11 @@ std::ostream& token::showType(std::ostream &s, type t)
         case OUTPUTS:   return s << ".outputs";
         case LATCH:     return s << ".latch";
         case ENDMODEL:  return s << ".end";
+        case SUBCKT:    return s << ".subckt";
+        case SEARCH:    return s << ".search";
 
         case IDENT:     return s << "identifier";
+        case EQUALS:    return s << "=";
 
         default:        return s << "???";
     }
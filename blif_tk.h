@@ -2,6 +2,40 @@
 #define BLIF_TK_H
 
 #include <iostream>
+#include <string>
+#include <string.h>
+
+/*
+ * Read-only view of token text.
+ * Points into the lexer's input buffer, so it is only
+ * valid while the lexer is alive; use str() to keep a copy.
+ */
+class strview {
+        const char* ptr;
+        unsigned len;
+    public:
+        strview() : ptr(""), len(0) { }
+        strview(const char* p, unsigned l) : ptr(p), len(l) { }
+
+        inline const char* data() const { return ptr; }
+        inline unsigned length() const { return len; }
+
+        /// Character i, or 0 past the end (like a C string)
+        inline char operator[](unsigned i) const {
+            return (i < len) ? ptr[i] : 0;
+        }
+
+        inline bool operator==(const char* text) const {
+            return (0==strncmp(ptr, text, len)) && (0==text[len]);
+        }
+
+        inline std::string str() const { return std::string(ptr, len); }
+};
+
+inline std::ostream& operator<<(std::ostream &s, const strview &v)
+{
+    return s.write(v.data(), v.length());
+}
 
 class token {
     public:
@@ -11,6 +45,7 @@ class token {
             NEWLINE     = 100,
 
             IDENT       = 200,
+            EQUALS      = 201,
             COVER       = 300,
             SO          = 301,
 
@@ -22,6 +57,8 @@ class token {
             LATCH       = 404,
             NAMES       = 405,
             ENDMODEL    = 406,
+            SUBCKT      = 407,
+            SEARCH      = 408,
 
             WIRE        = 500
 
@@ -29,7 +66,7 @@ class token {
     private:
         unsigned lineno;
         type tokenID;
-        std::string attribute;
+        strview attribute;
 
         static bool show_details;
     public:
@@ -40,7 +77,7 @@ class token {
         inline bool matches(type t) const { return t == tokenID; }
         inline type getId() const { return tokenID; }
         inline unsigned getLine() const { return lineno; }
-        inline const std::string& getAttr() const { return attribute; }
+        inline const strview& getAttr() const { return attribute; }
 
         static inline void setDetails() { show_details = true; }
 
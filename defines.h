@@ -8,3 +8,6 @@
 #define ASSERT(X)
 #endif
 
+
+// Phase timing and gate build histogram; see blif_phase.h
+// #define PHASE_TIMING
@@ -4,7 +4,9 @@
  * Timer is started when a timer object is initialized.
  * note_time() is used to note the current time.
  * get_last_interval() is the time between the last two instances when the
- * time was noted (in microseconds)
+ * time was noted (in microseconds).
+ * Uses the monotonic clock, so intervals are not thrown off
+ * when the wall clock is adjusted.
  *
  * */
 
@@ -12,27 +14,25 @@
 #define TIMERS_H
 
 #include "defines.h"
-#include <sys/time.h>
 #include <time.h>
 
 class timer 
 {
-	struct timeval curr_time, prev_time;
-	struct timezone time_zone;
+	struct timespec curr_time, prev_time;
 	long last_interval; 
 
 public:
 	timer()
 	{
-		gettimeofday(&curr_time, &time_zone);
+		clock_gettime(CLOCK_MONOTONIC, &curr_time);
 		prev_time = curr_time;
 	}
 
 	inline void note_time()
 	{
-		gettimeofday(&curr_time, &time_zone);
+		clock_gettime(CLOCK_MONOTONIC, &curr_time);
 		last_interval = (curr_time.tv_sec - prev_time.tv_sec) * 1000000;
-		last_interval += curr_time.tv_usec - prev_time.tv_usec;
+		last_interval += (curr_time.tv_nsec - prev_time.tv_nsec) / 1000;
 		prev_time = curr_time;
 	}
 